@@ -0,0 +1,326 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Throughput benchmark of an L1simulate build (see make bench). Runs a fixed
+// suite of workloads, the bundled traces and larger generated ones, at a few
+// representative cache geometries and reports the trace load time, accesses
+// and cycles simulated per second and peak RSS of each. The results go to a
+// CSV file that a later run can compare against with -c.
+
+struct BenchWorkload
+{
+    string name;
+    string prefix;
+    int cores;
+};
+
+struct BenchPoint
+{
+    int s;
+    int E;
+    int b;
+};
+
+struct BenchResult
+{
+    string workload;
+    int cores;
+    BenchPoint point;
+    long long accesses, cycles;
+    double loadSeconds, simSeconds;
+    long long peakRss;
+};
+
+const string BENCH_DIR = "bench_traces";
+
+// Program defaults, the README example and a large cache that mostly hits
+const BenchPoint BENCH_POINTS[] = {{2, 2, 4}, {6, 2, 5}, {10, 8, 6}};
+
+void printUsage(const char *progName)
+{
+    cout << "Usage: " << progName << " <simulator> [-o <outfilename>] [-c <baseline>] [-r <runs>] [-h]\n"
+         << "\nOptions:\n"
+         << "  <simulator>     L1simulate binary to measure (make bench builds it with -O2).\n"
+         << "  -o <outfilename>Write the results as CSV (default bench.csv).\n"
+         << "  -c <baseline>   CSV of an earlier run; prints the speedup over it and flags\n"
+         << "                  workloads whose simulated cycles changed.\n"
+         << "  -r <runs>       Runs per measurement, the fastest is kept (default 3).\n"
+         << "  -g <generator>  trace-gen binary for the generated workloads (default ./trace-gen).\n"
+         << "  -h              Print this help message.\n";
+}
+
+static bool fileExists(const string &filename)
+{
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0;
+}
+
+// Writes a generated workload with trace-gen unless its files exist. The
+// generator is deterministic, so every build measures the same traces.
+static bool generateTraces(const string &generator, const BenchWorkload &w, const string &options)
+{
+    if (fileExists(w.prefix + "_proc" + to_string(w.cores - 1) + ".trace"))
+    {
+        return true;
+    }
+    string command = generator + " -t " + w.prefix + " -n " + to_string(w.cores) + " " + options;
+    cout << command << endl;
+    if (system(command.c_str()) != 0)
+    {
+        cerr << "Error: " << command << " failed" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Runs the simulator once and reads its --timing report
+static bool runOnce(const string &simulator, const BenchWorkload &w, const BenchPoint &p, BenchResult &result)
+{
+    ostringstream command;
+    command << simulator << " -t " << w.prefix << " -n " << w.cores << " -s " << p.s << " -E " << p.E << " -b " << p.b
+            << " --timing 2>&1 >/dev/null";
+    FILE *pipe = popen(command.str().c_str(), "r");
+    if (!pipe)
+    {
+        cerr << "Error: Could not run " << simulator << endl;
+        return false;
+    }
+    int found = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), pipe))
+    {
+        string text = line;
+        size_t colon = text.find(": ");
+        if (colon == string::npos)
+        {
+            cerr << text;
+            continue;
+        }
+        string key = text.substr(0, colon);
+        const char *value = line + colon + 2;
+        if (key == "Trace Load Time (s)")
+            result.loadSeconds = atof(value), found++;
+        else if (key == "Simulation Time (s)")
+            result.simSeconds = atof(value), found++;
+        else if (key == "Accesses Simulated")
+            result.accesses = atoll(value), found++;
+        else if (key == "Simulated Cycles")
+            result.cycles = atoll(value), found++;
+        else if (key == "Peak RSS (KB)")
+            result.peakRss = atoll(value), found++;
+    }
+    if (pclose(pipe) != 0 || found != 5)
+    {
+        cerr << "Error: " << command.str() << " failed" << endl;
+        return false;
+    }
+    return true;
+}
+
+static string resultKey(const string &workload, const BenchPoint &p)
+{
+    return workload + "," + to_string(p.s) + "," + to_string(p.E) + "," + to_string(p.b);
+}
+
+// Reads the workload, geometry, cycles and accesses per second of a CSV
+// written by an earlier run
+static bool loadBaseline(const string &filename, map<string, pair<long long, double>> &baseline)
+{
+    ifstream in(filename);
+    if (!in.is_open())
+    {
+        cerr << "Error: Could not open baseline " << filename << endl;
+        return false;
+    }
+    string line;
+    getline(in, line); // Header
+    while (getline(in, line))
+    {
+        vector<string> fields;
+        stringstream fieldStream(line);
+        string field;
+        while (getline(fieldStream, field, ','))
+        {
+            fields.push_back(field);
+        }
+        if (fields.size() < 10)
+        {
+            continue;
+        }
+        BenchPoint p{atoi(fields[2].c_str()), atoi(fields[3].c_str()), atoi(fields[4].c_str())};
+        baseline[resultKey(fields[0], p)] = make_pair(atoll(fields[6].c_str()), atof(fields[9].c_str()));
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    string simulator;
+    string outfilename = "bench.csv";
+    string baselineFile;
+    string generator = "./trace-gen";
+    int runs = 3;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outfilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            baselineFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+        {
+            generator = argv[++i];
+        }
+        else if (argv[i][0] != '-' && simulator.empty())
+        {
+            simulator = argv[i];
+        }
+        else
+        {
+            cerr << "Error: Unknown option " << argv[i] << ".\n";
+            return 1;
+        }
+    }
+    if (simulator.empty() || runs < 1)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    map<string, pair<long long, double>> baseline;
+    if (!baselineFile.empty() && !loadBaseline(baselineFile, baseline))
+    {
+        return 1;
+    }
+
+    // The bundled traces, then generated ones that stress the hit path
+    // (private), the bus and coherence (shared), both on 8 cores (mixed)
+    // and the producer-consumer, migratory and false-sharing patterns
+    vector<BenchWorkload> workloads = {
+        {"test", "test", 4},
+        {"input1", "interesting_traces/input1", 2},
+        {"input2", "interesting_traces/input2", 2},
+        {"input3", "interesting_traces/input3", 1},
+        {"input4", "interesting_traces/input4", 1},
+        {"private", BENCH_DIR + "/private", 4},
+        {"shared", BENCH_DIR + "/shared", 4},
+        {"mixed", BENCH_DIR + "/mixed", 8},
+        {"sharing", BENCH_DIR + "/sharing", 4},
+    };
+    const char *GENERATED[] = {"-p private -l 500k -f 1m -w 25", "-p true -l 100k -f 64k",
+                               "-p random:90,true:10 -l 100k -f 64k", "-p producer,migratory,false -l 100k -f 4k"};
+    mkdir(BENCH_DIR.c_str(), 0755);
+    for (int k = 0; k < 4; k++)
+    {
+        if (!generateTraces(generator, workloads[5 + k], GENERATED[k]))
+        {
+            return 1;
+        }
+    }
+
+    ofstream out(outfilename);
+    if (!out.is_open())
+    {
+        cerr << "Error: Could not open output file " << outfilename << endl;
+        return 1;
+    }
+    out << "workload,cores,s,E,b,accesses,cycles,load_seconds,sim_seconds,accesses_per_second,cycles_per_second,peak_rss_kb\n";
+
+    cout << left << setw(9) << "Workload" << right << setw(4) << "s" << setw(4) << "E" << setw(4) << "b"
+         << setw(11) << "Accesses" << setw(12) << "Cycles" << setw(10) << "Load (s)" << setw(10) << "Sim (s)"
+         << setw(13) << "Accesses/s" << setw(13) << "Cycles/s" << setw(11) << "RSS (KB)";
+    if (!baseline.empty())
+    {
+        cout << setw(9) << "Speedup";
+    }
+    cout << "\n";
+
+    double logSpeedup = 0;
+    int compared = 0;
+    for (const BenchWorkload &w : workloads)
+    {
+        for (const BenchPoint &p : BENCH_POINTS)
+        {
+            BenchResult best{w.name, w.cores, p, 0, 0, 0, 0, 0};
+            for (int r = 0; r < runs; r++)
+            {
+                BenchResult result = best;
+                if (!runOnce(simulator, w, p, result))
+                {
+                    return 1;
+                }
+                if (r == 0 || result.simSeconds < best.simSeconds)
+                {
+                    best.simSeconds = result.simSeconds;
+                    best.accesses = result.accesses;
+                    best.cycles = result.cycles;
+                    best.peakRss = result.peakRss;
+                }
+                if (r == 0 || result.loadSeconds < best.loadSeconds)
+                {
+                    best.loadSeconds = result.loadSeconds;
+                }
+            }
+            double seconds = max(best.simSeconds, 1e-9);
+            double accessRate = best.accesses / seconds;
+            double cycleRate = best.cycles / seconds;
+            out << best.workload << "," << best.cores << "," << p.s << "," << p.E << "," << p.b << "," << best.accesses << ","
+                << best.cycles << "," << fixed << setprecision(6) << best.loadSeconds << "," << best.simSeconds << ","
+                << setprecision(0) << accessRate << "," << cycleRate << "," << best.peakRss << "\n";
+
+            cout << left << setw(9) << w.name << right << setw(4) << p.s << setw(4) << p.E << setw(4) << p.b
+                 << setw(11) << best.accesses << setw(12) << best.cycles << fixed << setprecision(4)
+                 << setw(10) << best.loadSeconds << setw(10) << best.simSeconds << setprecision(0)
+                 << setw(13) << accessRate << setw(13) << cycleRate << setw(11) << best.peakRss;
+            auto old = baseline.find(resultKey(w.name, p));
+            if (old != baseline.end() && old->second.second > 0)
+            {
+                double speedup = accessRate / old->second.second;
+                logSpeedup += log(speedup);
+                compared++;
+                cout << setprecision(2) << setw(8) << speedup << "x";
+                if (old->second.first != best.cycles)
+                {
+                    cout << "  (cycles changed from " << old->second.first << ")";
+                }
+            }
+            cout << "\n";
+        }
+    }
+    if (compared > 0)
+    {
+        cout << "Geometric mean speedup over " << baselineFile << ": " << setprecision(3) << exp(logSpeedup / compared) << "x\n";
+    }
+    if (!out)
+    {
+        cerr << "Error: Could not write " << outfilename << endl;
+        return 1;
+    }
+    cout << "Results written to " << outfilename << "\n";
+    return 0;
+}
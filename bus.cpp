@@ -9,24 +9,194 @@
 #include "main.hpp"
 #include "bus.hpp"
 #include "cache.hpp"
+#include "coherence.hpp"
 
-vector<int> corePendingOperation(4, -1); // -1 indicates no pending operation
-bool bus_busy = false;
-int cycle = 0;
-int cnt = 0;
-void bus()
+unsigned int Simulator::blockAddress(int index, int tag)
 {
-    cycle++;
-    while (busQueue.size())
+    return ((unsigned int)tag << s) | (unsigned int)index;
+}
+
+void Simulator::dirAdd(unsigned int block, int core, bool owner)
+{
+    auto it = sharerDirectory.find(block);
+    if (it == sharerDirectory.end())
+    {
+        it = sharerDirectory.emplace(block, SharerEntry{0, -1}).first;
+    }
+    it->second.sharers |= 1ULL << core;
+    if (owner)
+    {
+        it->second.owner = core;
+    }
+}
+
+void Simulator::dirRemove(unsigned int block, int core)
+{
+    auto it = sharerDirectory.find(block);
+    if (it == sharerDirectory.end())
+    {
+        return;
+    }
+    it->second.sharers &= ~(1ULL << core);
+    if (it->second.owner == core)
+    {
+        it->second.owner = -1;
+    }
+    if (it->second.sharers == 0)
+    {
+        sharerDirectory.erase(it);
+    }
+}
+
+void Simulator::dirClearOwner(unsigned int block)
+{
+    auto it = sharerDirectory.find(block);
+    if (it != sharerDirectory.end())
+    {
+        it->second.owner = -1;
+    }
+}
+
+unsigned long long Simulator::dirSharers(unsigned int block)
+{
+    auto it = sharerDirectory.find(block);
+    return it == sharerDirectory.end() ? 0 : it->second.sharers;
+}
+
+// Way holding a valid copy of the block in a core's set, or -1
+int Simulator::findLine(int core, int index, int tag)
+{
+    CacheLine *set = caches[core].set(index);
+    for (int j = 0; j < E; j++)
     {
-        BusReq busReq = busQueue.front();
-        busQueue.erase(busQueue.begin());
+        if (set[j].tag == (unsigned int)tag && set[j].state != MESIState::I)
+        {
+            return j;
+        }
+    }
+    return -1;
+}
+
+// Flags and transfer kind of event records
+static int eventFlags(const BusReq &req)
+{
+    return (req.mshr ? EVENT_MSHR : 0) | (req.prefetch ? EVENT_PREFETCH : 0) | (req.store ? EVENT_STORE : 0);
+}
+
+static int transferKind(const BusData &data)
+{
+    return data.writeback ? EVENT_WRITEBACK : data.inv ? EVENT_INVALIDATE : EVENT_FILL;
+}
+
+void Simulator::busRequest(const BusReq &req)
+{
+    busQueue.push_back(req);
+    logEvent(EventType::Issue, req.coreId, req.address, (int)req.type, eventFlags(req), 0);
+}
 
-        if (cycle % 100000 == 0)
+int Simulator::busQuietCycles()
+{
+    if (!bus_busy || busDataQueue.empty())
+    {
+        return 0;
+    }
+    for (size_t k = 0; k < busQueue.size(); k++)
+    {
+        if (!busQueue[k].mshr && corePendingOperation[busQueue[k].coreId] != -1)
         {
-            // cout << "Bus: " << busReq.coreId << " " << busReq.address << " " << (int)busReq.type << endl;
+            return 0; // bus() would still drop this request
         }
-        // cout << bus_busy << endl;
+    }
+    if (splitOutstanding == 0)
+    {
+        return busDataQueue.front().stalls;
+    }
+    if (!busQueue.empty() && busDataQueue.size() < (size_t)splitOutstanding)
+    {
+        return 0; // A request may be granted
+    }
+    int quiet = busDataQueue[0].stalls;
+    for (size_t k = 1; k < busDataQueue.size(); k++)
+    {
+        quiet = min(quiet, busDataQueue[k].stalls);
+    }
+    return quiet;
+}
+
+// Whether a transfer for the block of addr is in flight on the split bus
+bool Simulator::blockInFlight(int addr)
+{
+    for (size_t k = 0; k < busDataQueue.size(); k++)
+    {
+        if (((unsigned int)busDataQueue[k].address >> b) == ((unsigned int)addr >> b))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Simulator::busSkip(int cycles)
+{
+    cycle += cycles;
+    busQueueDepthSum += (long long)busQueue.size() * cycles;
+    for (size_t k = 0; k < busQueue.size(); k++)
+    {
+        if (busQueue[k].mshr)
+        {
+            continue;
+        }
+        int core = busQueue[k].coreId;
+        caches[core].stall = true;
+        idle_cycles[core] += cycles;
+    }
+    if (!busDataQueue.empty())
+    {
+        size_t counting = splitOutstanding == 0 ? 1 : busDataQueue.size();
+        for (size_t k = 0; k < counting; k++)
+        {
+            busDataQueue[k].stalls -= cycles;
+        }
+        busBusyCycles += cycles;
+    }
+}
+
+void Simulator::bus()
+{
+    cycle++;
+    busQueueDepthSum += busQueue.size();
+
+    // Grant a free bus to the waiting request from the lowest numbered core
+    // (fixed priority arbitration), demand requests ahead of prefetches;
+    // everyone else stays queued. A split bus
+    // is free while it has room for another transfer, and holds back requests
+    // for a block that is still in flight.
+    size_t pick = busQueue.size();
+    if (splitOutstanding == 0 ? !bus_busy : busDataQueue.size() < (size_t)splitOutstanding)
+    {
+        for (size_t k = 0; k < busQueue.size(); k++)
+        {
+            if (splitOutstanding > 0 && blockInFlight(busQueue[k].address))
+            {
+                busConflicts++;
+                continue;
+            }
+            if (pick == busQueue.size() || make_pair(busQueue[k].prefetch, busQueue[k].coreId) < make_pair(busQueue[pick].prefetch, busQueue[pick].coreId))
+            {
+                pick = k;
+            }
+        }
+    }
+    if (pick < busQueue.size())
+    {
+        BusReq busReq = busQueue[pick];
+        busQueue.erase(pick);
+        waitingForBus[busReq.coreId] = false;
+        int wait = cycle - 1 - busReq.issueCycle;
+        busWaitCycles += wait;
+        busMaxWait = max(busMaxWait, wait);
+        busGrants++;
+
         int core = busReq.coreId;
         int addr = busReq.address;
         BusReqType type = busReq.type;
@@ -34,225 +204,250 @@ void bus()
         int index = (addr >> b) & ((1 << s) - 1);
         int tag = addr >> (s + b);
 
-        if (bus_busy)
+        // An upgrade that waited may have lost its shared copy to another
+        // core's BusRdX in the meantime; it then needs the whole block.
+        if (type == BusReqType::BusUpgr)
         {
-            caches[core].stall = true;
-            idle_cycles[core]++;
-            continue;
+            int way = findLine(core, index, tag);
+            if (way == -1 || !sharedState(caches[core].set(index)[way].state))
+            {
+                type = BusReqType::BusRdX;
+            }
+        }
+
+        // A non-blocking cache's miss leaves the core running: only its MSHR
+        // waits for the fill, and no transfer of it holds the core.
+        logEvent(EventType::Grant, core, addr, (int)type, eventFlags(busReq), wait);
+        bool stalled = caches[core].stall;
+        int pending = corePendingOperation[core];
+        size_t queued = busDataQueue.size();
+        if (!busReq.mshr)
+        {
+            corePendingOperation[core] = addr;
         }
-        corePendingOperation[core] = addr;
         if (type == BusReqType::BusRd)
         {
-            bus_busy = true;
-            total_bus_transactions++; // Increment bus transaction counter
-            cache_misses[core]++;     // Increment miss counter
-            bool found = false;
-            for (int i = 0; i < 4; i++)
+            busRead(core, addr, index, tag);
+        }
+        else if (type == BusReqType::BusRdX)
+        {
+            busReadExclusive(core, addr, index, tag);
+        }
+        else if (type == BusReqType::BusUpgr)
+        {
+            busUpgrade(core, addr, index, tag);
+        }
+        if (busReq.mshr)
+        {
+            caches[core].stall = stalled;
+            corePendingOperation[core] = pending;
+            for (size_t k = queued; k < busDataQueue.size(); k++)
             {
-                if (i != core)
+                if (busDataQueue[k].coreId == core && !busDataQueue[k].writeback)
                 {
-                    for (int j = 0; j < E; j++)
-                    {
-                        if (caches[i].tags[index][j] == tag && mesiState[i][index][j] != MESIState::I)
-                        {
-                            found = true;
-                            caches[core].stall = true;                                                      // Set the stall flag for the requesting core
-                            busDataQueue.push_back(BusData{addr, core, false, false, false, 1 << (b - 1)}); // Send data to the requesting core
-                            data_traffic_bytes[i] += caches[i].blockSize;
-                            if (mesiState[i][index][j] == MESIState::M)
-                            {
-                                // Send BusRd to share the line with the requesting core
-                                mesiState[i][index][j] = MESIState::S;
-                                caches[i].stall = true;                                            // Set the stall flag for the core
-                                busDataQueue.push_back(BusData{addr, i, false, true, false, 100}); // Writeback data
-                                if (coreActive[i])
-                                {
-                                    clockCycles[i] -= ((1 << (b - 1)) + 101);
-                                    idle_cycles[i] += (1 << (b - 1)) + 1;
-                                }
-                                corePendingOperation[i] = addr;
-                            }
-                            else if (mesiState[i][index][j] == MESIState::E)
-                            {
-                                // Send BusRd to share the line with the requesting core
-                                mesiState[i][index][j] = MESIState::S;
-                            }
-
-                            break;
-                        }
-                    }
+                    busDataQueue[k].mshr = true;
+                    busDataQueue[k].prefetch = busReq.prefetch;
+                    busDataQueue[k].store = busReq.store;
                 }
-                if (found)
-                {
-                    break;
-                }
-            }
-            if (!found)
-            {
-                caches[core].stall = true;
-                busDataQueue.push_back(BusData{addr, core, false, false, false, 100}); // Send data to the requesting core
             }
         }
-        else if (type == BusReqType::BusRdX)
+        if (busReq.prefetch)
+        {
+            cache_misses[core]--; // Only demand misses count
+        }
+        if (classifyMisses && type != BusReqType::BusUpgr)
+        {
+            classifyMiss(core, addr, busReq.prefetch);
+        }
+        if (sharingTop > 0)
         {
-            bus_busy = true;
-            total_bus_transactions++; // Increment bus transaction counter
-            bool found = false;
-            cache_misses[core]++; // Increment miss counter
-            // Check if any other cache has this line and invalidate it
-            for (int i = 0; i < 4; i++)
+            int transfer = 0;
+            for (size_t k = queued; k < busDataQueue.size(); k++)
             {
-                if (i != core)
-                {
-                    for (int j = 0; j < E; j++)
-                    {
-                        if (caches[i].tags[index][j] == tag && mesiState[i][index][j] != MESIState::I)
-                        {
-                            found = true;
-                            // Invalidate the line
-                            if (mesiState[i][index][j] == MESIState::M)
-                            {
-                                // Send BusRd to share the line with the requesting core
-                                caches[i].stall = true;                                            // Set the stall flag for the core
-                                busDataQueue.push_back(BusData{addr, i, false, true, false, 100}); // Writeback data
-                                if (coreActive[i])
-                                    clockCycles[i] -= 101;
-                                corePendingOperation[i] = addr;
-                            }
-
-                            mesiState[i][index][j] = MESIState::I;
-                            // bus_invalidations[i]++; // Increment invalidation counter
-                        }
-                    }
-                }
+                transfer += busDataQueue[k].stalls;
             }
-            caches[core].stall = true; // Set the stall flag for the requesting core
-            if (found)
-                bus_invalidations[core]++; // Increment invalidation counter
-            busDataQueue.push_back(BusData{addr, core, true, false, false, 100});
+            sharingGrant(core, addr, type, busReq.prefetch, transfer);
         }
-        else if (type == BusReqType::BusUpgr)
+        if (events)
         {
-            // Find the cache line that needs to be upgraded
-            int target_line = -1;
-            for (int j = 0; j < E; j++)
+            for (size_t k = queued; k < busDataQueue.size(); k++)
             {
-                if (caches[core].tags[index][j] == tag && mesiState[core][index][j] == MESIState::S)
-                {
-                    target_line = j;
-                    break;
-                }
+                logEvent(EventType::TransferStart, busDataQueue[k].coreId, busDataQueue[k].address, transferKind(busDataQueue[k]), 0, busDataQueue[k].stalls);
             }
+        }
+    }
+    // Requests still waiting for the bus keep their cores stalled. A core
+    // that was just forced into a writeback by a snoop gives up its request.
+    // MSHR requests stay queued without holding their cores.
+    for (size_t k = 0; k < busQueue.size();)
+    {
+        if (busQueue[k].mshr)
+        {
+            k++;
+            continue;
+        }
+        int core = busQueue[k].coreId;
+        caches[core].stall = true;
+        idle_cycles[core]++;
+        if (corePendingOperation[core] != -1)
+        {
+            busQueue.erase(k);
+            waitingForBus[core] = false;
+            continue;
+        }
+        k++;
+    }
 
-            if (target_line != -1)
+    if (busDataQueue.empty())
+    {
+        return;
+    }
+    busBusyCycles++;
+    if (splitOutstanding == 0)
+    {
+        // Handle a single bus data operation if any
+        BusData &busData = busDataQueue.front();
+        if (busData.stalls == 0)
+        {
+            completeTransfer(BusData(busData));
+            busDataQueue.pop_front();
+            if (busDataQueue.empty())
             {
-                total_bus_transactions++; // Increment bus transaction counter
+                bus_busy = false;
+            }
+        }
+        else
+        {
+            busData.stalls--;
+        }
+        return;
+    }
 
-                // Invalidate copies in other caches
-                for (int i = 0; i < 4; i++)
-                {
-                    if (i != core)
-                    {
-                        for (int j = 0; j < E; j++)
-                        {
-                            if (caches[i].tags[index][j] == tag && mesiState[i][index][j] != MESIState::I)
-                            {
-                                mesiState[i][index][j] = MESIState::I; // Invalidate the line in other caches
-                                // bus_invalidations[i]++;                // Increment invalidation counter
-                            }
-                        }
-                    }
-                }
+    // Split transactions: every transfer in flight counts down at once and
+    // the finished ones complete in issue order. Writebacks they start wait
+    // for the next cycle.
+    size_t inFlight = busDataQueue.size();
+    for (size_t k = 0, seen = 0; seen < inFlight; seen++)
+    {
+        if (busDataQueue[k].stalls == 0)
+        {
+            BusData busData = busDataQueue[k];
+            busDataQueue.erase(k);
+            completeTransfer(busData);
+        }
+        else
+        {
+            busDataQueue[k].stalls--;
+            k++;
+        }
+    }
+    if (busDataQueue.empty())
+    {
+        bus_busy = false;
+    }
+}
 
-                // Upgrade the state to Modified
-                bus_invalidations[core]++; // Increment invalidation counter
-                bus_busy = true;
-                mesiState[core][index][target_line] = MESIState::M;
-                caches[core].dirty[index][target_line] = true; // Mark the line as dirty
-                caches[core].stall = true;
-                busDataQueue.push_back(BusData{addr, core, false, false, true, 0}); // Inv
-                corePendingOperation[core] = 1;
+// A transfer has finished: fill the requester's cache or retire the
+// writeback, and let the core go on once nothing else of it is in flight.
+void Simulator::completeTransfer(const BusData &busData)
+{
+    int bytes = busData.update ? 4 : caches[busData.coreId].blockSize; // A Dragon update carries one word
+    total_bus_traffic_bytes += bytes;                                   // Increment bus traffic counter
+    int core = busData.coreId;
+    int addr = busData.address;
+    bool isWrite = busData.write;
+    bool isWriteback = busData.writeback;
+    bool inv = busData.inv;
+    data_traffic_bytes[core] += bytes; // Add writeback traffic
+    logEvent(EventType::TransferEnd, core, addr, transferKind(busData), 0, bytes);
+    if (busData.prefetch)
+    {
+        prefetchTrafficBytes[core] += bytes;
+    }
+    bool evictwriteback = false;
+    bool release = !busData.mshr;
+    if (splitOutstanding > 0)
+    {
+        for (size_t k = 0; k < busDataQueue.size(); k++)
+        {
+            if (busDataQueue[k].coreId == core && !busDataQueue[k].mshr)
+            {
+                release = false;
             }
         }
     }
-    // Handle a single bus data operation if any
-    if (!busDataQueue.empty())
+    bool stalled = caches[core].stall;
+    if (!isWriteback)
     {
-        BusData &busData = busDataQueue.front();
-        if (busData.stalls == 0)
+        int index = (addr >> b) & ((1 << s) - 1);
+        int tag = addr >> (s + b);
+        if (isWrite)
         {
-            total_bus_traffic_bytes += caches[busData.coreId].blockSize; // Increment bus traffic counter
-            int core = busData.coreId;
-            int addr = busData.address;
-            bool isWrite = busData.write;
-            bool isWriteback = busData.writeback;
-            bool inv = busData.inv;
-            data_traffic_bytes[core] += caches[core].blockSize; // Add writeback traffic
-            bool evictwriteback = false;
-            if (!isWriteback)
+            int way = handle_write_miss(core, index, tag, evictwriteback);
+            unsigned int block = blockAddress(index, tag);
+            bool otherCachesHaveData = (dirSharers(block) & ~(1ULL << core)) != 0;
+            caches[core].set(index)[way].state = writeFillState(otherCachesHaveData); // Modified (or Dragon's shared modified)
+            dirAdd(block, core, true);
+            logEvent(EventType::Fill, core, addr, (int)MESIState::I, (int)caches[core].set(index)[way].state, 0);
+        }
+        else if (!inv)
+        {
+            int way = handle_read_miss(core, index, tag, evictwriteback);
+            unsigned int block = blockAddress(index, tag);
+            bool otherCachesHaveData = (dirSharers(block) & ~(1ULL << core)) != 0;
+            MESIState state = readFillState(otherCachesHaveData);
+            caches[core].set(index)[way].state = state;
+            dirAdd(block, core, state != MESIState::S); // E and F answer later reads
+            logEvent(EventType::Fill, core, addr, (int)MESIState::I, (int)state, 0);
+            if (busData.prefetch)
             {
-                int index = (addr >> b) & ((1 << s) - 1);
-                int tag = addr >> (s + b);
-                if (isWrite)
-                {
-                    int way = handle_write_miss(core, index, tag, evictwriteback);
-                    mesiState[core][index][way] = MESIState::M; // Set to Modified state
-                }
-                else if (!inv)
-                {
-                    int way = handle_read_miss(core, index, tag, evictwriteback);
-                    bool otherCachesHaveData = false;
-                    for (int j = 0; j < 4; j++)
-                    {
-                        if (j != core)
-                        {
-                            for (int k = 0; k < E; k++)
-                            {
-                                if (caches[j].tags[index][k] == tag && mesiState[j][index][k] != MESIState::I)
-                                {
-                                    otherCachesHaveData = true;
-                                    break;
-                                }
-                            }
-                        }
-                        if (otherCachesHaveData)
-                            break;
-                    }
-                    if (otherCachesHaveData)
-                    {
-                        mesiState[core][index][way] = MESIState::S;
-                    }
-                    else
-                    {
-
-                        mesiState[core][index][way] = MESIState::E;
-                    }
-                }
-                caches[core].stall = false;
-                // clockCycles[core]++;
-                corePendingOperation[core] = -1;
-                if (evictwriteback)
-                {
-                    caches[core].stall = true;
-                    corePendingOperation[core] = 1;
-                }
+                prefetchFilled(core, addr, caches[core].set(index)[way]);
             }
-            else
+        }
+        if (release)
+        {
+            caches[core].stall = false;
+            // clockCycles[core]++;
+            corePendingOperation[core] = -1;
+        }
+        if (busData.mshr)
+        {
+            // The fill frees its MSHR; the block it evicts is written back
+            // behind the core's back
+            if (busData.store)
             {
-                writebacks[core]++;
-                caches[core].stall = false;
-                corePendingOperation[core] = -1;
+                storeRetire(core);
             }
-
-            busDataQueue.erase(busDataQueue.begin());
-            if (busDataQueue.empty())
+            else if (!busData.prefetch)
             {
-                bus_busy = false;
+                mshrRetire(core, addr);
+            }
+            caches[core].stall = stalled;
+            if (evictwriteback)
+            {
+                busDataQueue.back().mshr = true;
+                busDataQueue.back().prefetch = busData.prefetch;
             }
         }
-        else
+        else if (evictwriteback)
         {
-            busData.stalls--;
+            caches[core].stall = true;
+            corePendingOperation[core] = 1;
+        }
+        if (evictwriteback)
+        {
+            BusData &wb = busDataQueue.back();
+            logEvent(EventType::TransferStart, core, wb.address, EVENT_WRITEBACK, 0, wb.stalls);
         }
     }
+    else
+    {
+        writebacks[core]++;
+        if (release)
+        {
+            caches[core].stall = false;
+            corePendingOperation[core] = -1;
+        }
+    }
+
 }
\ No newline at end of file
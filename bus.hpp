@@ -3,10 +3,10 @@
 
 #include <vector>
 #include <set>
+#include <unordered_map>
 using namespace std;
 // Enum for different types of bus transactions in MESI protocol
 
-void bus();
 enum class BusReqType {
     BusRd,     // Read from memory (shared or modified line needed)
     BusRdX,    // Read for exclusive (write) — others must invalidate
@@ -18,6 +18,10 @@ struct BusReq {
     int coreId;                 // ID of the core making the request
     int address;           // 32-bit memory address
     BusReqType type;            // Type of bus request
+    int issueCycle;             // Cycle the request was issued by the core
+    bool mshr = false;          // Miss of a non-blocking cache or a prefetch; the core does not wait for it
+    bool prefetch = false;      // Prefetch: granted only when no demand request waits
+    bool store = false;         // Drains the oldest entry of the core's store buffer
 };
 
 struct BusData {
@@ -27,8 +31,82 @@ struct BusData {
     bool writeback;       // Indicates if the data is being written back to memory
     bool inv;
     int stalls;           // Number of stalls for the bus transaction
+    bool update = false;  // Dragon word update rather than a whole block
+    bool mshr = false;    // Fill (or its eviction writeback) the core does not wait for
+    bool prefetch = false; // Prefetch fill (or its eviction writeback)
+    bool store = false;    // Transfer that completes the oldest buffered store
+};
+
+// Fixed-capacity FIFO ring buffer used for the bus queues. Capacity is a power
+// of two; it doubles in the unlikely case a push finds it full.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 16) { reset(capacity); }
+
+    void reset(size_t capacity)
+    {
+        size_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        buf.assign(cap, T());
+        head = count = 0;
+        highWater = 0;
+    }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return buf.size(); }
+    void clear() { head = count = 0; }
+
+    T &front() { return buf[head]; }
+    T &back() { return buf[(head + count - 1) & (buf.size() - 1)]; }
+    T &operator[](size_t i) { return buf[(head + i) & (buf.size() - 1)]; }
+
+    void push_back(const T &value)
+    {
+        if (count == buf.size())
+            grow();
+        buf[(head + count) & (buf.size() - 1)] = value;
+        count++;
+        if (count > highWater)
+            highWater = count;
+    }
+    void pop_front()
+    {
+        head = (head + 1) & (buf.size() - 1);
+        count--;
+    }
+    // Remove the i-th entry from the front, keeping the order of the rest
+    void erase(size_t i)
+    {
+        for (; i + 1 < count; i++)
+            (*this)[i] = (*this)[i + 1];
+        count--;
+    }
+
+    size_t highWater; // Largest size seen since reset
+
+private:
+    void grow()
+    {
+        vector<T> bigger(buf.size() * 2);
+        for (size_t i = 0; i < count; i++)
+            bigger[i] = (*this)[i];
+        buf.swap(bigger);
+        head = 0;
+    }
+
+    vector<T> buf;
+    size_t head;
+    size_t count;
+};
+
+// Sharer directory (snoop filter): for every block held by at least one
+// cache, which cores have a valid copy and which core owns it in M or E.
+// Snoops look up the block here instead of scanning every core's set.
+struct SharerEntry {
+    unsigned long long sharers; // Bit i set when core i holds a valid copy
+    int owner;                  // Core holding the block in M or E, -1 if none
 };
 
-extern vector<BusReq> busQueue;
-extern vector<BusData> busDataQueue;
 #endif // BUS_HPP
@@ -8,44 +8,239 @@
 #include <cstdlib>
 #include "main.hpp"
 #include "bus.hpp"
+#include "cache.hpp"
 
 using namespace std;
 
-// Declaring the external variable defined in bus.cpp
-extern vector<int> corePendingOperation;
-extern vector<int> num_reads;
-extern vector<int> num_writes;
-extern vector<int> cache_misses;
-extern vector<int> cache_evictions;
-extern vector<int> writebacks;
-extern vector<long long> data_traffic_bytes;
-int cycle2 = 0;
-int parseHexAddress(const string &address)
+const char *replPolicyName(ReplPolicy policy)
 {
-    string hexPart = address;
-    if (hexPart.length() >= 2 && (hexPart.substr(0, 2) == "0x" || hexPart.substr(0, 2) == "0X"))
+    switch (policy)
     {
-        hexPart = hexPart.substr(2);
+    case ReplPolicy::LRU:
+        return "LRU";
+    case ReplPolicy::PLRU:
+        return "Tree-PLRU";
+    case ReplPolicy::SRRIP:
+        return "SRRIP";
+    case ReplPolicy::BRRIP:
+        return "BRRIP";
+    default:
+        return "Random";
     }
-    int addr_val = stoul(hexPart, nullptr, 16);
-    stringstream ss;
-    ss << "0x" << setfill('0') << setw(8) << hex << addr_val;
-    string paddedAddress = ss.str();
+}
+
+int replStateBits(ReplPolicy policy, int E)
+{
+    int wayBits = 0;
+    while ((1 << wayBits) < E)
+        wayBits++;
+    switch (policy)
+    {
+    case ReplPolicy::LRU:
+        return E * wayBits; // Recency rank per line
+    case ReplPolicy::PLRU:
+        return E - 1; // One bit per internal tree node
+    case ReplPolicy::SRRIP:
+    case ReplPolicy::BRRIP:
+        return 2 * E; // 2-bit RRPV per line
+    default:
+        return 0; // None; the victim comes from the cache's xorshift state
+    }
+}
+
+int replCacheStateBits(ReplPolicy policy)
+{
+    switch (policy)
+    {
+    case ReplPolicy::BRRIP:
+        return 5; // Fill counter, one distant-insertion exception in 32
+    case ReplPolicy::Random:
+        return 32; // xorshift state
+    default:
+        return 0;
+    }
+}
+
+void Cache::init(int s, int b, int E, ReplPolicy replacementPolicy)
+{
+    policy = replacementPolicy;
+    sets = 1 << s;      // Number of sets = 2^s
+    blockSize = 1 << b; // Block size = 2^b bytes
+    ways = E;
+
+    // One allocation for the whole cache. Initial LRU stamps give the same
+    // order as filling ways 0..E-1 in turn, so way 0 is the first victim.
+    lines.assign((size_t)sets * ways, CacheLine{0, 0, MESIState::I, false, false});
+    for (int i = 0; i < sets; i++)
+    {
+        for (int j = 0; j < ways; j++)
+        {
+            lines[(size_t)i * ways + j].stamp = (replacementPolicy == ReplPolicy::LRU) ? j : RRPV_MAX;
+        }
+    }
+    clock = ways;
+
+    plruLeaves = 1;
+    while (plruLeaves < ways)
+        plruLeaves <<= 1;
+    plruNodes = plruLeaves - 1;
+    plru.assign(policy == ReplPolicy::PLRU ? (size_t)sets * plruNodes : 0, 0);
 
-    return addr_val;
+    rng = 2463534242u;
+    fills = 0;
+    invalidFills = 0;
+    searchSteps = 0;
+}
+
+void Cache::touch(int index, int way)
+{
+    switch (policy)
+    {
+    case ReplPolicy::LRU:
+        if (clock == 0xffffffffu)
+        {
+            renumber();
+        }
+        set(index)[way].stamp = clock++;
+        break;
+    case ReplPolicy::PLRU:
+        plruUpdate(index, way);
+        break;
+    case ReplPolicy::SRRIP:
+    case ReplPolicy::BRRIP:
+        set(index)[way].stamp = 0; // Hit priority: predict near re-reference
+        break;
+    case ReplPolicy::Random:
+        break;
+    }
 }
 
-int handle_read_miss(int core, int index, int tag, bool &iswriteback)
+void Cache::fill(int index, int way)
+{
+    switch (policy)
+    {
+    case ReplPolicy::SRRIP:
+        set(index)[way].stamp = RRPV_MAX - 1; // Long re-reference interval
+        break;
+    case ReplPolicy::BRRIP:
+        // Distant insertion, except for one fill in 32
+        set(index)[way].stamp = (fills++ % 32 == 0) ? RRPV_MAX - 1 : RRPV_MAX;
+        break;
+    default:
+        touch(index, way);
+        break;
+    }
+}
+
+int Cache::victim(int index)
+{
+    CacheLine *lines = set(index);
+    switch (policy)
+    {
+    case ReplPolicy::LRU:
+    {
+        int lruWay = 0;
+        for (int j = 1; j < ways; j++)
+        {
+            if (lines[j].stamp < lines[lruWay].stamp)
+            {
+                lruWay = j;
+            }
+        }
+        searchSteps += ways;
+        return lruWay;
+    }
+    case ReplPolicy::PLRU:
+    {
+        // Follow the node bits; a subtree made only of padding ways (when E
+        // is not a power of two) is never chosen.
+        unsigned char *bits = &plru[(size_t)index * plruNodes];
+        int node = 0, lo = 0, width = plruLeaves;
+        while (width > 1)
+        {
+            width >>= 1;
+            bool right = bits[node] && lo + width < ways;
+            searchSteps++;
+            if (right)
+                lo += width;
+            node = 2 * node + (right ? 2 : 1);
+        }
+        return lo;
+    }
+    case ReplPolicy::SRRIP:
+    case ReplPolicy::BRRIP:
+        // First line predicted for distant re-reference; age the set until one is
+        while (true)
+        {
+            for (int j = 0; j < ways; j++)
+            {
+                searchSteps++;
+                if (lines[j].stamp >= RRPV_MAX)
+                    return j;
+            }
+            for (int j = 0; j < ways; j++)
+                lines[j].stamp++;
+        }
+    default:
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        searchSteps++;
+        return rng % ways;
+    }
+}
+
+// Point every node on the path to a way away from it.
+void Cache::plruUpdate(int index, int way)
+{
+    unsigned char *bits = &plru[(size_t)index * plruNodes];
+    int node = 0, lo = 0, width = plruLeaves;
+    while (width > 1)
+    {
+        width >>= 1;
+        bool right = way >= lo + width;
+        bits[node] = right ? 0 : 1;
+        if (right)
+            lo += width;
+        node = 2 * node + (right ? 2 : 1);
+    }
+}
+
+// Compact the LRU stamps of every set to 0..E-1 (keeping their order) before
+// the stamp counter wraps around.
+void Cache::renumber()
+{
+    vector<int> order(ways);
+    for (int i = 0; i < sets; i++)
+    {
+        CacheLine *lines = set(i);
+        for (int j = 0; j < ways; j++)
+        {
+            order[j] = j;
+        }
+        sort(order.begin(), order.end(), [lines](int x, int y)
+             { return lines[x].stamp < lines[y].stamp; });
+        for (int j = 0; j < ways; j++)
+        {
+            lines[order[j]].stamp = j;
+        }
+    }
+    clock = ways;
+}
+
+int Simulator::handle_read_miss(int core, int index, int tag, bool &iswriteback)
 {
     Cache &cache = caches[core];
+    CacheLine *set = cache.set(index);
     int target_line = -1;
 
     // Try to find an invalid line first
     for (int i = 0; i < E; i++)
     {
-        if (mesiState[core][index][i] == MESIState::I)
+        if (set[i].state == MESIState::I)
         {
             target_line = i;
+            cache.invalidFills++;
             break;
         }
     }
@@ -53,48 +248,50 @@ int handle_read_miss(int core, int index, int tag, bool &iswriteback)
     // If all lines are valid, evict the least recently used (LRU) block
     if (target_line == -1)
     {
-        target_line = cache.lru[index].front();
-        cache.lru[index].erase(cache.lru[index].begin());
+        target_line = cache.victim(index);
         cache_evictions[core]++; // Increment eviction counter
+        if (classifyMisses)
+        {
+            missClassifiers[core].setEvictions[index]++;
+        }
+        prefetchLost(core, set[target_line], false);
+        dirRemove(blockAddress(index, set[target_line].tag), core);
 
-        if (cache.dirty[index][target_line])
+        if (set[target_line].dirty)
         {
             caches[core].stall = true; // Set the stall flag for the requesting core
-            int old_tag = cache.tags[index][target_line];
+            int old_tag = set[target_line].tag;
             int old_addr = (old_tag << (s + b)) | (index << b);
-            busDataQueue.push_back(BusData{old_addr, core, false, true, false, 100}); // Writeback data
-            iswriteback = true;                                                       // Indicate that a writeback occurred
+            busDataQueue.push_back(BusData{old_addr, core, false, true, false, writebackStalls(core, old_addr, false)}); // Writeback data
+            iswriteback = true;                                                                                            // Indicate that a writeback occurred
         }
-    }
-    else
-    {
-        // Remove the chosen block from LRU if it exists there
-        auto it = find(cache.lru[index].begin(), cache.lru[index].end(), target_line);
-        if (it != cache.lru[index].end())
+        else
         {
-            cache.lru[index].erase(it);
+            cleanEviction(core, (set[target_line].tag << (s + b)) | (index << b));
         }
     }
 
     // Load the block from memory and update metadata
-    cache.tags[index][target_line] = tag;
-    // cout << " " << "hi" << cache.tags[index][target_line] << endl;
-    cache.dirty[index][target_line] = false; // It's a read miss
-    cache.lru[index].push_back(target_line); // Mark as most recently used
+    set[target_line].tag = tag;
+    set[target_line].dirty = false;  // It's a read miss
+    set[target_line].prefetched = false;
+    cache.fill(index, target_line); // Insert per the replacement policy
     return target_line;                      // Return the target line index
 }
 
-int handle_write_miss(int core, int index, int tag, bool &iswriteback)
+int Simulator::handle_write_miss(int core, int index, int tag, bool &iswriteback)
 {
     Cache &cache = caches[core];
+    CacheLine *set = cache.set(index);
     int target_line = -1;
 
     // Try to find an invalid line first
     for (int i = 0; i < E; i++)
     {
-        if (mesiState[core][index][i] == MESIState::I)
+        if (set[i].state == MESIState::I)
         {
             target_line = i;
+            cache.invalidFills++;
             break;
         }
     }
@@ -102,103 +299,203 @@ int handle_write_miss(int core, int index, int tag, bool &iswriteback)
     // If no invalid line, evict the least recently used (LRU) block
     if (target_line == -1)
     {
-        target_line = cache.lru[index].front();
-        cache.lru[index].erase(cache.lru[index].begin());
+        target_line = cache.victim(index);
         cache_evictions[core]++; // Increment eviction counter
-        if (cache.dirty[index][target_line])
+        if (classifyMisses)
+        {
+            missClassifiers[core].setEvictions[index]++;
+        }
+        prefetchLost(core, set[target_line], false);
+        dirRemove(blockAddress(index, set[target_line].tag), core);
+        if (set[target_line].dirty)
         {
-            int old_tag = cache.tags[index][target_line];
+            int old_tag = set[target_line].tag;
             int old_addr = (old_tag << (s + b)) | (index << b);
-            busDataQueue.push_back(BusData{old_addr, core, false, true, false, 100}); // Writeback data
-            iswriteback = true;                                                       // Indicate that a writeback occurred
+            busDataQueue.push_back(BusData{old_addr, core, false, true, false, writebackStalls(core, old_addr, false)}); // Writeback data
+            iswriteback = true;                                                                                            // Indicate that a writeback occurred
         }
-    }
-    else
-    {
-        // Remove the selected block from its LRU position if it exists
-        auto it = find(cache.lru[index].begin(), cache.lru[index].end(), target_line);
-        if (it != cache.lru[index].end())
+        else
         {
-            cache.lru[index].erase(it);
+            cleanEviction(core, (set[target_line].tag << (s + b)) | (index << b));
         }
     }
 
     // Update the cache metadata for the new block
-    cache.tags[index][target_line] = tag;
-    cache.dirty[index][target_line] = true;  // It's a write miss
-    cache.lru[index].push_back(target_line); // Mark as most recently used
+    set[target_line].tag = tag;
+    set[target_line].dirty = true;   // It's a write miss
+    set[target_line].prefetched = false;
+    cache.fill(index, target_line); // Insert per the replacement policy
     return target_line;
 }
 
-void run(pair<char, const char *> entry, int core)
+int Simulator::hitStreak(int core, int limit)
 {
-    cycle2++;
-    // Extract access type and address from the trace entry
-    char accessType = entry.first;
-    string address = entry.second;
+    const vector<TraceAccess> &trace = (*traces)[core];
+    size_t pos = tracePos[core];
+    if (pos >= trace.size())
+    {
+        return 0;
+    }
+    // The last access is left to the serial kernel, which retires the core
+    size_t left = min(trace.size() - pos - 1, (size_t)limit);
+    vector<int> &ways = hitWays[core];
+    ways.resize(left);
+    size_t n = 0;
+    for (; n < left; n++)
+    {
+        const TraceAccess &entry = trace[pos + n];
+        int addr = entry.address;
+        int index = (addr >> b) & ((1 << s) - 1);
+        int tag = addr >> (s + b);
+        int way = findLine(core, index, tag);
+        if (way == -1)
+        {
+            break;
+        }
+        // A prefetched block's first use trains the prefetcher, so it is
+        // left to run() as well
+        const CacheLine &line = caches[core].set(index)[way];
+        if (line.prefetched || (entry.write && sharedState(line.state)))
+        {
+            break;
+        }
+        ways[n] = way;
+    }
+    return (int)n;
+}
+
+// Same effect as run() on each of the next count accesses, all of them hits
+// in the ways the last hitStreak() found
+void Simulator::applyHits(int core, int count)
+{
+    const vector<TraceAccess> &trace = (*traces)[core];
+    const vector<int> &ways = hitWays[core];
+    Cache &cache = caches[core];
+    size_t pos = tracePos[core];
+    for (int n = 0; n < count; n++)
+    {
+        const TraceAccess &entry = trace[pos + n];
+        int addr = entry.address;
+        int index = (addr >> b) & ((1 << s) - 1);
+        int way = ways[n];
+        cache.touch(index, way);
+        if (sharingTop > 0)
+        {
+            sharingAccess(core, entry);
+        }
+        if (classifyMisses)
+        {
+            classifyAccess(core, entry);
+        }
+        if (entry.write)
+        {
+            CacheLine &line = cache.set(index)[way];
+            line.dirty = true;
+            line.state = MESIState::M;
+        }
+    }
+    tracePos[core] += count;
+    instructions[core] += count;
+}
 
-    // Parse the hexadecimal address
-    int addr = parseHexAddress(address);
+void Simulator::run(const TraceAccess &entry, int core)
+{
+    cycle2++;
+    // Extract access type and address from the trace entry (already decoded by the loader)
+    char accessType = entry.write ? 'W' : 'R';
+    int addr = entry.address;
     // If this core already has a pending operation, skip issuing a new request
     if (corePendingOperation[core] != -1)
     {
         clockCycles[core]++;
         return;
     }
-    // Increment read/write counters
-    if (cycle2 % 100000 == 0)
+    // A request already queued for the bus is not reissued
+    if (waitingForBus[core])
+    {
+        return;
+    }
+    // A core held back by its MSHRs, a late prefetch or its store buffer
+    // tries again
+    if (mshrCount > 0 || prefetcher != PrefetchKind::None || storeBufferDepth > 0)
     {
-        // cout << "Core " << core << " Access Type: " << accessType << ", Address: " << address << " " << caches[core].stall << endl;
+        caches[core].stall = false;
     }
 
     // Extract index and tag fields from the address
     int index = (addr >> b) & ((1 << s) - 1); // index bits
     int tag = addr >> (s + b);                // tag bits
-    // cout << index << " " << tag << endl;
     bool hit = false;
     int hit_line = -1;
 
     // Use a reference to the core's cache for easier access
     Cache &cache = caches[core];
+    CacheLine *set = cache.set(index);
 
     if (accessType == 'R')
     {
         // Check every line in the set for a tag match
         for (int i = 0; i < E; i++)
         {
-            if (mesiState[core][index][i] != MESIState::I && cache.tags[index][i] == tag)
+            if (set[i].state != MESIState::I && set[i].tag == (unsigned int)tag)
             {
                 hit = true;
                 hit_line = i;
                 break;
             }
         }
+        if (storeBufferDepth > 0 && !storeBuffers[core].empty() && storeLoad(core, addr, hit))
+        {
+            return;
+        }
 
         if (hit)
         {
             // Cache hit: Update the LRU ordering for the set
-            auto it = find(cache.lru[index].begin(), cache.lru[index].end(), hit_line);
-            if (it != cache.lru[index].end())
+            cache.touch(index, hit_line);
+            if (set[hit_line].prefetched)
             {
-                cache.lru[index].erase(it);
+                prefetchUsed(core, addr, set[hit_line]);
             }
-            cache.lru[index].push_back(hit_line);
             // clockCycles[core]++;
             // caches[core].stall = false;
         }
+        else if (prefetcher != PrefetchKind::None && prefetchWait(core, addr))
+        {
+            // The block is already being prefetched
+        }
+        else if (mshrCount > 0)
+        {
+            if (mshrMiss(core, addr, false) && prefetcher != PrefetchKind::None)
+            {
+                prefetchTrain(core, addr, true);
+            }
+        }
         else
         {
-            // cout << "Core " << core << " Access Type: " << accessType << ", Address: " << address << " " << caches[core].stall << endl;
-            busQueue.push_back(BusReq{core, addr, BusReqType::BusRd});
+            if (classifyMisses)
+            {
+                classifyIssue(core, addr);
+            }
+            busRequest(BusReq{core, addr, BusReqType::BusRd, cycle});
+            waitingForBus[core] = true;
             caches[core].stall = true; // Set the stall flag for the requesting core
+            if (prefetcher != PrefetchKind::None)
+            {
+                prefetchTrain(core, addr, true);
+            }
         }
     }
     else
     { // Write access
+        if (storeBufferDepth > 0 && storeWrite(core, addr))
+        {
+            return;
+        }
         // Search for a matching block in the set
         for (int i = 0; i < E; i++)
         {
-            if (mesiState[core][index][i] != MESIState::I && cache.tags[index][i] == tag)
+            if (set[i].state != MESIState::I && set[i].tag == (unsigned int)tag)
             {
                 hit = true;
                 hit_line = i;
@@ -208,24 +505,19 @@ void run(pair<char, const char *> entry, int core)
 
         if (hit)
         {
-            if (cycle2 % 100000 == 0)
+            if (set[hit_line].prefetched)
             {
-                // cout << "Core " << core << " Access Type: " << accessType << ", Address: " << address << " " << "hit" << endl;
+                prefetchUsed(core, addr, set[hit_line]);
             }
 
             // Cache hit: update the LRU order and mark the block as dirty
-            if (mesiState[core][index][hit_line] == MESIState::E || mesiState[core][index][hit_line] == MESIState::M)
+            if (set[hit_line].state == MESIState::E || set[hit_line].state == MESIState::M)
             {
-                auto it = find(cache.lru[index].begin(), cache.lru[index].end(), hit_line);
-                if (it != cache.lru[index].end())
-                {
-                    cache.lru[index].erase(it);
-                }
-                cache.lru[index].push_back(hit_line);
-                cache.dirty[index][hit_line] = true;
-                if (mesiState[core][index][hit_line] == MESIState::E)
+                cache.touch(index, hit_line);
+                set[hit_line].dirty = true;
+                if (set[hit_line].state == MESIState::E)
                 {
-                    mesiState[core][index][hit_line] = MESIState::M; // Upgrade to M state
+                    set[hit_line].state = MESIState::M; // Upgrade to M state
                 }
                 // clockCycles[core]++;
                 // caches[core].stall = false;
@@ -233,22 +525,37 @@ void run(pair<char, const char *> entry, int core)
             else
             {
                 // If the block is in the S state, send a BusUpgr request to upgrade it to M state
-                busQueue.push_back(BusReq{core, addr, BusReqType::BusUpgr});
+                busRequest(BusReq{core, addr, BusReqType::BusUpgr, cycle});
+                waitingForBus[core] = true;
                 // caches[core].stall = true;
                 //  Update the LRU order for the block
-                auto it = find(cache.lru[index].begin(), cache.lru[index].end(), hit_line);
-                if (it != cache.lru[index].end())
-                {
-                    cache.lru[index].erase(it);
-                }
-                cache.lru[index].push_back(hit_line);
+                cache.touch(index, hit_line);
+            }
+        }
+        else if (prefetcher != PrefetchKind::None && prefetchWait(core, addr))
+        {
+            // The block is already being prefetched
+        }
+        else if (mshrCount > 0)
+        {
+            if (mshrMiss(core, addr, true) && prefetcher != PrefetchKind::None)
+            {
+                prefetchTrain(core, addr, true);
             }
         }
         else
         {
-            // cout << "Core " << core << " Access Type: " << accessType << ", Address: " << address << " " << caches[core].stall << endl;
-            busQueue.push_back(BusReq{core, addr, BusReqType::BusRdX});
+            if (classifyMisses)
+            {
+                classifyIssue(core, addr);
+            }
+            busRequest(BusReq{core, addr, BusReqType::BusRdX, cycle});
+            waitingForBus[core] = true;
             caches[core].stall = true;
+            if (prefetcher != PrefetchKind::None)
+            {
+                prefetchTrain(core, addr, true);
+            }
         }
     }
 }
\ No newline at end of file
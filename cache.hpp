@@ -4,12 +4,101 @@
 #include <vector>
 #include <utility>
 
-void run(std::pair<char, const char *> entry, int core);
+using namespace std;
 
-int handle_read_miss(int core, int index, int tag, bool &iswriteback);
+enum class MESIState : unsigned char
+{
+    M,
+    E,
+    S,
+    I,
+    O, // Owned (MOESI) / shared modified (Dragon)
+    F  // Forward (MESIF)
+};
 
-// Handles a write miss for a given core, index, and tag
-int handle_write_miss(int core, int index, int tag, bool &iswriteback);
+// Replacement policies selectable with -r
+enum class ReplPolicy
+{
+    LRU,    // True LRU via last-use stamps
+    PLRU,   // Tree pseudo-LRU
+    SRRIP,  // Static re-reference interval prediction (2-bit RRPV)
+    BRRIP,  // Bimodal RRIP: mostly distant insertion
+    Random
+};
+const unsigned int RRPV_MAX = 3; // 2-bit re-reference prediction values
 
-// Runs a single memory operation (read/write) for a given core
-#endif // CACHE_HPP
\ No newline at end of file
+// How the shared last-level cache (--llc) relates to the L1 contents
+enum class LlcPolicy
+{
+    Inclusive,    // Holds every L1 block; its evictions back-invalidate L1 copies
+    NonInclusive, // Filled on misses, but evicts without touching the L1s
+    Exclusive     // Holds only L1 victims; a hit moves the block up to the L1
+};
+
+// One cache line. Lines of a set are stored next to each other so a probe or
+// snoop touches a single contiguous run of memory (8 lines = 96 bytes).
+struct CacheLine
+{
+    unsigned int tag;   // Tag bits of the cached block
+    unsigned int stamp; // Replacement metadata: LRU stamp or RRPV
+    MESIState state;    // Coherence state (I = invalid)
+    bool dirty;         // Dirty bit
+    bool prefetched;    // Brought in by a prefetch and not used yet
+};
+
+// Miss-status holding register of a non-blocking cache (--mshr): a block
+// being fetched and whether the fetch is for writing (BusRdX).
+struct Mshr
+{
+    unsigned int block; // Block number (address >> b)
+    bool write;
+};
+
+// Structure to hold a cache's per-core data.
+struct Cache
+{
+    int sets;      // Number of sets = 2^s
+    int blockSize; // Block size = 2^b bytes
+    int ways;      // Lines per set = E
+    bool stall;
+    vector<CacheLine> lines; // All lines, set-major: line j of set i is lines[i * ways + j]
+    vector<Mshr> mshrs;      // Misses in flight, oldest first (--mshr)
+    unsigned int clock;      // Next LRU stamp
+
+    vector<unsigned char> plru; // Tree-PLRU node bits, plruNodes per set
+    int plruNodes;
+    int plruLeaves;          // ways rounded up to a power of two
+    unsigned int rng;        // xorshift state for Random
+    unsigned int fills;      // Fill counter for BRRIP's bimodal insertion
+
+    ReplPolicy policy;
+    long long invalidFills; // Fills that found an invalid line
+    long long searchSteps;  // Lines/nodes examined or aged while picking victims
+
+    // Initialize the cache for 2^s sets of E lines of 2^b bytes.
+    void init(int s, int b, int E, ReplPolicy replacementPolicy);
+
+    // First line of a set
+    CacheLine *set(int index) { return &lines[(size_t)index * ways]; }
+
+    // Replacement hooks: a hit on a line, a new block placed in a line, and
+    // the line to evict from a full set.
+    void touch(int index, int way);
+    void fill(int index, int way);
+    int victim(int index);
+
+private:
+    void renumber();
+    void plruUpdate(int index, int way);
+};
+
+// Name of a replacement policy as printed in the results
+const char *replPolicyName(ReplPolicy policy);
+// Bits of replacement state each set of E lines needs in hardware
+int replStateBits(ReplPolicy policy, int E);
+// Bits of replacement state shared by all sets of a cache
+int replCacheStateBits(ReplPolicy policy);
+// Name of an LLC inclusion policy as printed in the results
+const char *llcPolicyName(LlcPolicy policy);
+
+#endif // CACHE_HPP
@@ -0,0 +1,438 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include "main.hpp"
+
+using namespace std;
+
+// Checkpoint file: the magic "L1CK", a version byte, the configuration and
+// trace lengths it was taken with, then every piece of simulator state in
+// declaration order. Values are stored in host byte order; a checkpoint is
+// meant to be restored by the same build on the same machine.
+static const char CHECKPOINT_MAGIC[4] = {'L', '1', 'C', 'K'};
+static const unsigned char CHECKPOINT_VERSION = 8;
+
+namespace
+{
+
+template <typename T>
+void put(string &out, const T &value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void putVector(string &out, const vector<T> &values)
+{
+    put(out, (unsigned long long)values.size());
+    if (!values.empty())
+        out.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+void putBools(string &out, const vector<bool> &values)
+{
+    put(out, (unsigned long long)values.size());
+    for (bool v : values)
+        put(out, (unsigned char)v);
+}
+
+template <typename T>
+void putQueue(string &out, RingBuffer<T> &queue)
+{
+    put(out, (unsigned long long)queue.size());
+    put(out, (unsigned long long)queue.highWater);
+    for (size_t i = 0; i < queue.size(); i++)
+        put(out, queue[i]);
+}
+
+// Reads back what put() wrote; any read past the end marks the input bad
+struct Reader
+{
+    const string &data;
+    size_t pos;
+    bool ok;
+
+    template <typename T>
+    T get()
+    {
+        T value{};
+        if (pos + sizeof(T) > data.size())
+        {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    // The stored vector must have the size the simulator already gave it
+    template <typename T>
+    void getVector(vector<T> &values)
+    {
+        if (get<unsigned long long>() != values.size() || pos + values.size() * sizeof(T) > data.size())
+        {
+            ok = false;
+            return;
+        }
+        if (values.empty())
+            return; // data() may be null
+        memcpy(values.data(), data.data() + pos, values.size() * sizeof(T));
+        pos += values.size() * sizeof(T);
+    }
+
+    void getBools(vector<bool> &values)
+    {
+        if (get<unsigned long long>() != values.size())
+        {
+            ok = false;
+            return;
+        }
+        for (size_t i = 0; i < values.size(); i++)
+            values[i] = get<unsigned char>() != 0;
+    }
+
+    template <typename T>
+    void getQueue(RingBuffer<T> &queue)
+    {
+        unsigned long long n = get<unsigned long long>();
+        unsigned long long highWater = get<unsigned long long>();
+        if (n > data.size())
+        {
+            ok = false;
+            return;
+        }
+        queue.clear();
+        for (unsigned long long i = 0; i < n && ok; i++)
+            queue.push_back(get<T>());
+        queue.highWater = highWater;
+    }
+};
+
+} // namespace
+
+// Trace length of a core, 0 when it is streamed and not known in advance
+static unsigned long long traceLength(Simulator &sim, int core)
+{
+    return sim.streams ? 0 : (*sim.traces)[core].size();
+}
+
+bool Simulator::saveCheckpoint(const string &filename)
+{
+    string out(CHECKPOINT_MAGIC, 4);
+    put(out, CHECKPOINT_VERSION);
+    put(out, s);
+    put(out, b);
+    put(out, E);
+    put(out, numCores);
+    put(out, replacementPolicy);
+    put(out, protocol);
+    put(out, splitOutstanding);
+    put(out, mshrCount);
+    put(out, prefetcher);
+    put(out, prefetchDegree);
+    put(out, storeBufferDepth);
+    put(out, llcEnabled);
+    put(out, llcS);
+    put(out, llcE);
+    put(out, llcB);
+    put(out, llcLatency);
+    put(out, llcPolicy);
+    for (int i = 0; i < numCores; i++)
+        put(out, traceLength(*this, i));
+
+    for (Cache &cache : caches)
+    {
+        put(out, cache.stall);
+        putVector(out, cache.lines);
+        put(out, cache.clock);
+        putVector(out, cache.plru);
+        put(out, cache.rng);
+        put(out, cache.fills);
+        put(out, cache.invalidFills);
+        put(out, cache.searchSteps);
+        put(out, (unsigned long long)cache.mshrs.size());
+        putVector(out, cache.mshrs);
+    }
+
+    if (llcEnabled)
+    {
+        putVector(out, llc.lines);
+        put(out, llc.clock);
+        putVector(out, llc.plru);
+        put(out, llc.rng);
+        put(out, llc.fills);
+        put(out, llc.invalidFills);
+        put(out, llc.searchSteps);
+    }
+
+    putQueue(out, busQueue);
+    putQueue(out, busDataQueue);
+    put(out, (unsigned long long)sharerDirectory.size());
+    for (const auto &entry : sharerDirectory)
+    {
+        put(out, entry.first);
+        put(out, entry.second);
+    }
+    putVector(out, corePendingOperation);
+    putBools(out, waitingForBus);
+    put(out, bus_busy);
+    put(out, cycle);
+    put(out, cycle2);
+
+    putVector(out, tracePos);
+    putBools(out, coreActive);
+    put(out, globalCycle);
+    put(out, maxtime);
+
+    putVector(out, instructions);
+    putVector(out, clockCycles);
+    putVector(out, cache_misses);
+    putVector(out, cache_evictions);
+    putVector(out, writebacks);
+    putVector(out, bus_invalidations);
+    putVector(out, bus_updates);
+    putVector(out, data_traffic_bytes);
+    putVector(out, idle_cycles);
+    put(out, total_bus_transactions);
+    put(out, total_bus_traffic_bytes);
+    put(out, busQueueDepthSum);
+    put(out, busWaitCycles);
+    put(out, busGrants);
+    put(out, busMaxWait);
+    put(out, busBusyCycles);
+    put(out, busConflicts);
+    putVector(out, llcHits);
+    putVector(out, llcMisses);
+    putVector(out, llcBackInvalidations);
+    putVector(out, memoryTrafficBytes);
+    put(out, memoryWritebacks);
+    putVector(out, mshrAllocations);
+    putVector(out, mshrMerges);
+    putVector(out, mshrFullCycles);
+    putVector(out, mshrOccupancy);
+    putVector(out, mshrPeak);
+    putVector(out, prefetchTrainers);
+    for (const vector<PrefetchPending> &pending : prefetchPending)
+    {
+        put(out, (unsigned long long)pending.size());
+        putVector(out, pending);
+    }
+    putVector(out, prefetchIssued);
+    putVector(out, prefetchUseful);
+    putVector(out, prefetchLate);
+    putVector(out, prefetchUseless);
+    putVector(out, prefetchInvalidated);
+    putVector(out, prefetchTrafficBytes);
+    for (const vector<int> &buffer : storeBuffers)
+    {
+        put(out, (unsigned long long)buffer.size());
+        putVector(out, buffer);
+    }
+    putBools(out, storeInFlight);
+    putVector(out, storesBuffered);
+    putVector(out, storeForwards);
+    putVector(out, storeFullCycles);
+    putVector(out, storeOccupancy);
+    putVector(out, storePeak);
+
+    ofstream file(filename, ios::binary);
+    if (!file.is_open())
+    {
+        cerr << "Error: Could not open checkpoint file " << filename << endl;
+        return false;
+    }
+    file.write(out.data(), out.size());
+    return (bool)file;
+}
+
+bool Simulator::loadCheckpoint(const string &filename)
+{
+    ifstream file(filename, ios::binary);
+    if (!file.is_open())
+    {
+        cerr << "Error: Could not open checkpoint file " << filename << endl;
+        return false;
+    }
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (data.size() < 5 || memcmp(data.data(), CHECKPOINT_MAGIC, 4) != 0 || (unsigned char)data[4] != CHECKPOINT_VERSION)
+    {
+        cerr << "Error: " << filename << " is not a checkpoint of this version." << endl;
+        return false;
+    }
+    Reader in{data, 5, true};
+
+    int cs = in.get<int>(), cb = in.get<int>(), cE = in.get<int>(), cores = in.get<int>();
+    ReplPolicy policy = in.get<ReplPolicy>();
+    if (cs != s || cb != b || cE != E || cores != numCores || policy != replacementPolicy)
+    {
+        cerr << "Error: Checkpoint was taken with -s " << cs << " -E " << cE << " -b " << cb << " -n " << cores
+             << ", " << replPolicyName(policy) << " replacement; run with the same options." << endl;
+        return false;
+    }
+    if (in.get<Protocol>() != protocol)
+    {
+        cerr << "Error: Checkpoint was taken with a different coherence protocol." << endl;
+        return false;
+    }
+    if (in.get<int>() != splitOutstanding)
+    {
+        cerr << "Error: Checkpoint was taken with a different --split setting." << endl;
+        return false;
+    }
+    if (in.get<int>() != mshrCount)
+    {
+        cerr << "Error: Checkpoint was taken with a different --mshr setting." << endl;
+        return false;
+    }
+    PrefetchKind kind = in.get<PrefetchKind>();
+    if (kind != prefetcher || in.get<int>() != prefetchDegree)
+    {
+        cerr << "Error: Checkpoint was taken with a different --prefetch setting." << endl;
+        return false;
+    }
+    if (in.get<int>() != storeBufferDepth)
+    {
+        cerr << "Error: Checkpoint was taken with a different --store-buffer setting." << endl;
+        return false;
+    }
+    bool withLlc = in.get<bool>();
+    int ls = in.get<int>(), lE = in.get<int>(), lb = in.get<int>(), latency = in.get<int>();
+    LlcPolicy inclusion = in.get<LlcPolicy>();
+    if (withLlc != llcEnabled || ls != llcS || lE != llcE || lb != llcB || latency != llcLatency || inclusion != llcPolicy)
+    {
+        cerr << "Error: Checkpoint was taken with different --llc options." << endl;
+        return false;
+    }
+    for (int i = 0; i < numCores; i++)
+    {
+        unsigned long long length = in.get<unsigned long long>();
+        if (length && traceLength(*this, i) && length != traceLength(*this, i))
+        {
+            cerr << "Error: Trace of core " << i << " differs from the one the checkpoint was taken with." << endl;
+            return false;
+        }
+    }
+
+    for (Cache &cache : caches)
+    {
+        cache.stall = in.get<bool>();
+        in.getVector(cache.lines);
+        cache.clock = in.get<unsigned int>();
+        in.getVector(cache.plru);
+        cache.rng = in.get<unsigned int>();
+        cache.fills = in.get<unsigned int>();
+        cache.invalidFills = in.get<long long>();
+        cache.searchSteps = in.get<long long>();
+        unsigned long long mshrs = in.get<unsigned long long>();
+        if (mshrs > (unsigned long long)mshrCount)
+        {
+            in.ok = false;
+            break;
+        }
+        cache.mshrs.resize(mshrs);
+        in.getVector(cache.mshrs);
+    }
+
+    if (llcEnabled)
+    {
+        in.getVector(llc.lines);
+        llc.clock = in.get<unsigned int>();
+        in.getVector(llc.plru);
+        llc.rng = in.get<unsigned int>();
+        llc.fills = in.get<unsigned int>();
+        llc.invalidFills = in.get<long long>();
+        llc.searchSteps = in.get<long long>();
+    }
+
+    in.getQueue(busQueue);
+    in.getQueue(busDataQueue);
+    sharerDirectory.clear();
+    unsigned long long entries = in.get<unsigned long long>();
+    for (unsigned long long k = 0; k < entries && in.ok; k++)
+    {
+        unsigned int block = in.get<unsigned int>();
+        sharerDirectory[block] = in.get<SharerEntry>();
+    }
+    in.getVector(corePendingOperation);
+    in.getBools(waitingForBus);
+    bus_busy = in.get<bool>();
+    cycle = in.get<int>();
+    cycle2 = in.get<int>();
+
+    in.getVector(tracePos);
+    in.getBools(coreActive);
+    globalCycle = in.get<int>();
+    maxtime = in.get<int>();
+
+    in.getVector(instructions);
+    in.getVector(clockCycles);
+    in.getVector(cache_misses);
+    in.getVector(cache_evictions);
+    in.getVector(writebacks);
+    in.getVector(bus_invalidations);
+    in.getVector(bus_updates);
+    in.getVector(data_traffic_bytes);
+    in.getVector(idle_cycles);
+    total_bus_transactions = in.get<int>();
+    total_bus_traffic_bytes = in.get<long long>();
+    busQueueDepthSum = in.get<long long>();
+    busWaitCycles = in.get<long long>();
+    busGrants = in.get<long long>();
+    busMaxWait = in.get<int>();
+    busBusyCycles = in.get<long long>();
+    busConflicts = in.get<long long>();
+    in.getVector(llcHits);
+    in.getVector(llcMisses);
+    in.getVector(llcBackInvalidations);
+    in.getVector(memoryTrafficBytes);
+    memoryWritebacks = in.get<long long>();
+    in.getVector(mshrAllocations);
+    in.getVector(mshrMerges);
+    in.getVector(mshrFullCycles);
+    in.getVector(mshrOccupancy);
+    in.getVector(mshrPeak);
+    in.getVector(prefetchTrainers);
+    for (vector<PrefetchPending> &pending : prefetchPending)
+    {
+        unsigned long long n = in.get<unsigned long long>();
+        if (n > (unsigned long long)PREFETCH_QUEUE)
+        {
+            in.ok = false;
+            break;
+        }
+        pending.resize(n);
+        in.getVector(pending);
+    }
+    in.getVector(prefetchIssued);
+    in.getVector(prefetchUseful);
+    in.getVector(prefetchLate);
+    in.getVector(prefetchUseless);
+    in.getVector(prefetchInvalidated);
+    in.getVector(prefetchTrafficBytes);
+    for (vector<int> &buffer : storeBuffers)
+    {
+        unsigned long long n = in.get<unsigned long long>();
+        if (n > (unsigned long long)storeBufferDepth)
+        {
+            in.ok = false;
+            break;
+        }
+        buffer.resize(n);
+        in.getVector(buffer);
+    }
+    in.getBools(storeInFlight);
+    in.getVector(storesBuffered);
+    in.getVector(storeForwards);
+    in.getVector(storeFullCycles);
+    in.getVector(storeOccupancy);
+    in.getVector(storePeak);
+
+    if (!in.ok || in.pos != data.size())
+    {
+        cerr << "Error: Checkpoint file " << filename << " is truncated or corrupt." << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,276 @@
+#include <iostream>
+#include "main.hpp"
+#include "coherence.hpp"
+
+using namespace std;
+
+const int UPDATE_STALLS = 2; // Dragon: one word on the bus (2 cycles per word)
+
+const char *protocolName(Protocol protocol)
+{
+    switch (protocol)
+    {
+    case Protocol::MESI:
+        return "MESI";
+    case Protocol::MOESI:
+        return "MOESI";
+    case Protocol::MESIF:
+        return "MESIF";
+    default:
+        return "Dragon";
+    }
+}
+
+// State a snooped copy moves to when another core reads the block. MESI and
+// MESIF write a modified block back first; MOESI and Dragon keep it dirty and
+// go on supplying it.
+MESIState Simulator::readSnoopState(MESIState state, bool &writeback)
+{
+    writeback = false;
+    switch (state)
+    {
+    case MESIState::M:
+        if (protocol == Protocol::MOESI || protocol == Protocol::Dragon)
+        {
+            return MESIState::O;
+        }
+        writeback = true;
+        return MESIState::S;
+    case MESIState::O:
+        return MESIState::O;
+    default:
+        return MESIState::S;
+    }
+}
+
+// State of a block a read miss brings in, depending on whether other caches
+// hold it: under MESIF the newest sharer becomes the forwarder.
+MESIState Simulator::readFillState(bool shared)
+{
+    if (!shared)
+    {
+        return MESIState::E;
+    }
+    return protocol == Protocol::MESIF ? MESIState::F : MESIState::S;
+}
+
+// State of a written block after a write miss or an upgrade; only Dragon
+// leaves other copies behind, and then the writer owns it.
+MESIState Simulator::writeFillState(bool shared)
+{
+    return (protocol == Protocol::Dragon && shared) ? MESIState::O : MESIState::M;
+}
+
+void Simulator::busRead(int core, int addr, int index, int tag)
+{
+    bus_busy = true;
+    total_bus_transactions++; // Increment bus transaction counter
+    cache_misses[core]++;     // Increment miss counter
+    unsigned int block = blockAddress(index, tag);
+    auto entry = sharerDirectory.find(block);
+    unsigned long long others = (entry == sharerDirectory.end()) ? 0 : entry->second.sharers & ~(1ULL << core);
+
+    // The owner answers if there is one, otherwise the lowest numbered
+    // sharer; under MESIF plain sharers stay silent and memory answers.
+    int i = -1;
+    if (others)
+    {
+        int owner = entry->second.owner;
+        if (owner >= 0 && owner != core)
+            i = owner;
+        else if (protocol != Protocol::MESIF)
+            i = __builtin_ctzll(others);
+    }
+    caches[core].stall = true; // Set the stall flag for the requesting core
+    if (i == -1)
+    {
+        busDataQueue.push_back(BusData{addr, core, false, false, false, fetchStalls(core, addr)}); // Send data to the requesting core
+        return;
+    }
+
+    CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+    busDataQueue.push_back(BusData{addr, core, false, false, false, 1 << (b - 1)}); // Send data to the requesting core
+    data_traffic_bytes[i] += caches[i].blockSize;
+    bool writeback;
+    MESIState snooped = line.state;
+    line.state = readSnoopState(line.state, writeback);
+    logEvent(EventType::Snoop, i, addr, (int)snooped, (int)line.state, core);
+    if (writeback)
+    {
+        caches[i].stall = true; // Set the stall flag for the core
+        int wb = writebackStalls(i, addr, true);
+        busDataQueue.push_back(BusData{addr, i, false, true, false, wb}); // Writeback data
+        if (coreActive[i])
+        {
+            clockCycles[i] -= ((1 << (b - 1)) + wb + 1);
+            idle_cycles[i] += (1 << (b - 1)) + 1;
+        }
+        corePendingOperation[i] = addr;
+    }
+    if (line.state != MESIState::O)
+    {
+        dirClearOwner(block);
+    }
+}
+
+void Simulator::busReadExclusive(int core, int addr, int index, int tag)
+{
+    bus_busy = true;
+    total_bus_transactions++; // Increment bus transaction counter
+    bool found = false;
+    cache_misses[core]++; // Increment miss counter
+    unsigned int block = blockAddress(index, tag);
+    unsigned long long others = dirSharers(block) & ~(1ULL << core);
+
+    if (protocol == Protocol::Dragon)
+    {
+        // Write-update: the block is read like a BusRd, then the written word
+        // is broadcast and the other copies stay valid as clean sharers.
+        caches[core].stall = true;
+        if (!others)
+        {
+            busDataQueue.push_back(BusData{addr, core, true, false, false, fetchStalls(core, addr)});
+            return;
+        }
+        int owner = sharerDirectory[block].owner;
+        int supplier = (owner >= 0 && owner != core) ? owner : __builtin_ctzll(others);
+        for (int i = 0; others; i++, others >>= 1)
+        {
+            if (others & 1)
+            {
+                CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+                logEvent(EventType::Snoop, i, addr, (int)line.state, (int)MESIState::S, core);
+                line.state = MESIState::S;
+            }
+        }
+        dirClearOwner(block);
+        bus_updates[core]++;
+        data_traffic_bytes[supplier] += caches[supplier].blockSize;
+        busDataQueue.push_back(BusData{addr, core, true, false, false, (1 << (b - 1)) + UPDATE_STALLS});
+        return;
+    }
+
+    // Check if any other cache has this line and invalidate it. A dirty copy
+    // is written back, except under MOESI where its owner hands it over.
+    int supplier = -1;
+    for (int i = 0; others; i++, others >>= 1)
+    {
+        if (!(others & 1))
+        {
+            continue;
+        }
+        found = true;
+        CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+        if (line.state == MESIState::M || line.state == MESIState::O)
+        {
+            if (protocol == Protocol::MOESI)
+            {
+                supplier = i;
+            }
+            else
+            {
+                caches[i].stall = true; // Set the stall flag for the core
+                int wb = writebackStalls(i, addr, false);
+                busDataQueue.push_back(BusData{addr, i, false, true, false, wb}); // Writeback data
+                if (coreActive[i])
+                    clockCycles[i] -= wb + 1;
+                corePendingOperation[i] = addr;
+            }
+        }
+
+        logEvent(EventType::Snoop, i, addr, (int)line.state, (int)MESIState::I, core);
+        line.state = MESIState::I;
+        prefetchLost(i, line, true);
+        dirRemove(block, i);
+        if (sharingTop > 0)
+        {
+            sharingInvalidate(i, block);
+        }
+        if (classifyMisses)
+        {
+            classifyInvalidate(i, block);
+        }
+    }
+    caches[core].stall = true; // Set the stall flag for the requesting core
+    if (found)
+        bus_invalidations[core]++; // Increment invalidation counter
+    if (supplier >= 0)
+    {
+        data_traffic_bytes[supplier] += caches[supplier].blockSize;
+        busDataQueue.push_back(BusData{addr, core, true, false, false, 1 << (b - 1)});
+    }
+    else
+    {
+        busDataQueue.push_back(BusData{addr, core, true, false, false, fetchStalls(core, addr)});
+    }
+}
+
+void Simulator::busUpgrade(int core, int addr, int index, int tag)
+{
+    // Find the shared copy that is being written
+    int target_line = -1;
+    CacheLine *coreSet = caches[core].set(index);
+    for (int j = 0; j < E; j++)
+    {
+        if (coreSet[j].tag == (unsigned int)tag && sharedState(coreSet[j].state))
+        {
+            target_line = j;
+            break;
+        }
+    }
+    if (target_line == -1)
+    {
+        return;
+    }
+
+    total_bus_transactions++; // Increment bus transaction counter
+    unsigned int block = blockAddress(index, tag);
+    unsigned long long others = dirSharers(block) & ~(1ULL << core);
+    bool update = protocol == Protocol::Dragon;
+    bool shared = others != 0;
+    for (int i = 0; others; i++, others >>= 1)
+    {
+        if (others & 1)
+        {
+            // Dragon updates the other copies (an owner among them gives up
+            // ownership); the other protocols invalidate them.
+            CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+            logEvent(EventType::Snoop, i, addr, (int)line.state, (int)(update ? MESIState::S : MESIState::I), core);
+            line.state = update ? MESIState::S : MESIState::I;
+            if (!update)
+            {
+                prefetchLost(i, line, true);
+                dirRemove(block, i);
+                if (sharingTop > 0)
+                {
+                    sharingInvalidate(i, block);
+                }
+                if (classifyMisses)
+                {
+                    classifyInvalidate(i, block);
+                }
+            }
+        }
+    }
+    dirAdd(block, core, true);
+
+    if (update)
+    {
+        if (shared)
+            bus_updates[core]++;
+    }
+    else
+    {
+        bus_invalidations[core]++; // Increment invalidation counter
+    }
+    bus_busy = true;
+    MESIState upgraded = writeFillState(shared && update);
+    logEvent(EventType::Fill, core, addr, (int)coreSet[target_line].state, (int)upgraded, 0);
+    coreSet[target_line].state = upgraded;
+    coreSet[target_line].dirty = true; // Mark the line as dirty
+    caches[core].stall = true;
+    BusData data{addr, core, false, false, true, update ? UPDATE_STALLS : 0}; // Inv or update
+    data.update = update;
+    busDataQueue.push_back(data);
+    corePendingOperation[core] = 1;
+}
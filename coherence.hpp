@@ -0,0 +1,31 @@
+#ifndef COHERENCE_HPP
+#define COHERENCE_HPP
+
+#include "cache.hpp"
+
+// Snooping coherence protocols selectable with -p. All of them share the
+// line states of MESIState; each uses the subset it needs:
+//   MESI   M E S I       (Illinois: any sharer can supply a block)
+//   MOESI  M O E S I     O = dirty and shared; reads of an M line need no writeback
+//   MESIF  M E S I F     F = the one clean sharer that answers reads
+//   Dragon M O E S       write-update: O = Sm (shared modified), S = Sc
+// The per-protocol decisions live in the Simulator hooks of coherence.cpp;
+// bus() only sequences the transactions.
+enum class Protocol
+{
+    MESI,
+    MOESI,
+    MESIF,
+    Dragon
+};
+
+// Name of a protocol as printed in the results
+const char *protocolName(Protocol protocol);
+
+// A valid copy that other caches may also hold, so writing it needs the bus
+inline bool sharedState(MESIState state)
+{
+    return state == MESIState::S || state == MESIState::O || state == MESIState::F;
+}
+
+#endif // COHERENCE_HPP
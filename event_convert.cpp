@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <tuple>
+#include <cstring>
+#include "events.hpp"
+
+using namespace std;
+
+// Converts an L1simulate --events log into Chrome trace JSON, which
+// chrome://tracing and ui.perfetto.dev open as a timeline (one cycle shown
+// as one microsecond). Process "Bus" has a track per core with that core's
+// transfers and a counter of the transfers in flight; process "Cores" shows
+// each core's bus waits, stalls and the snoops and fills its cache saw.
+
+static const char *STATE_NAMES = "MESIOF";
+static const char *REQUEST_NAMES[] = {"BusRd", "BusRdX", "BusUpgr"};
+static const char *TRANSFER_NAMES[] = {"fill", "writeback", "invalidate"};
+
+void printUsage(const char *progName)
+{
+    cout << "Usage: " << progName << " <events> [<outfilename>]\n"
+         << "\nWrites the Chrome trace JSON of an L1simulate --events log to <outfilename>\n"
+         << "(default <events>.json).\n";
+}
+
+static string requestName(const EventRecord &e)
+{
+    string name = e.a < 3 ? REQUEST_NAMES[e.a] : "?";
+    if (e.b & EVENT_PREFETCH)
+        name += " (prefetch)";
+    else if (e.b & EVENT_STORE)
+        name += " (store buffer)";
+    else if (e.b & EVENT_MSHR)
+        name += " (MSHR)";
+    return name;
+}
+
+static string stateName(int state)
+{
+    return string(1, state < 6 ? STATE_NAMES[state] : '?');
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3 || strcmp(argv[1], "-h") == 0)
+    {
+        printUsage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+    string inName = argv[1];
+    string outName = argc == 3 ? argv[2] : inName + ".json";
+
+    ifstream in(inName, ios::binary);
+    char magic[4];
+    unsigned char version = 0;
+    int numCores = 0, blockBits = 0;
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char *>(&version), 1);
+    in.read(reinterpret_cast<char *>(&numCores), sizeof(int));
+    in.read(reinterpret_cast<char *>(&blockBits), sizeof(int));
+    if (!in || memcmp(magic, EVENT_MAGIC, 4) != 0 || version != EVENT_VERSION)
+    {
+        cerr << "Error: " << inName << " is not an event log of this version.\n";
+        return 1;
+    }
+
+    ofstream out(outName);
+    if (!out.is_open())
+    {
+        cerr << "Error: Could not open output file " << outName << endl;
+        return 1;
+    }
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Bus\"}},\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Cores\"}}";
+    for (int i = 0; i < numCores; i++)
+    {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":\"Core " << i << " transfers\"}}";
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":\"Core " << i << "\"}}";
+    }
+
+    // Open transfers by (core, block, kind), and each core's blocking request
+    map<tuple<int, unsigned int, int>, deque<int>> transfers;
+    vector<int> stallStart(numCores, -1);
+    vector<unsigned int> stallBlock(numCores, 0);
+    int inFlight = 0;
+    long long records = 0;
+
+    EventRecord e;
+    while (in.read(reinterpret_cast<char *>(&e), sizeof(e)))
+    {
+        records++;
+        unsigned int block = e.address >> blockBits;
+        string where = ",\"pid\":1,\"tid\":" + to_string(e.core);
+        switch ((EventType)e.type)
+        {
+        case EventType::Issue:
+            out << ",\n{\"name\":\"issue " << requestName(e) << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << e.cycle << where
+                << ",\"args\":{\"address\":" << e.address << "}}";
+            if (e.b == 0 && e.core < numCores)
+            {
+                stallStart[e.core] = e.cycle;
+                stallBlock[e.core] = block;
+            }
+            break;
+        case EventType::Grant:
+            out << ",\n{\"name\":\"wait " << requestName(e) << "\",\"ph\":\"X\",\"ts\":" << e.cycle - e.arg << ",\"dur\":" << e.arg << where
+                << ",\"args\":{\"address\":" << e.address << "}}";
+            break;
+        case EventType::Snoop:
+            out << ",\n{\"name\":\"snoop " << stateName(e.a) << "->" << stateName(e.b) << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << e.cycle << where
+                << ",\"args\":{\"address\":" << e.address << ",\"requester\":" << e.arg << "}}";
+            break;
+        case EventType::Fill:
+            out << ",\n{\"name\":\"fill " << stateName(e.a) << "->" << stateName(e.b) << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << e.cycle << where
+                << ",\"args\":{\"address\":" << e.address << "}}";
+            break;
+        case EventType::TransferStart:
+            transfers[make_tuple(e.core, block, e.a)].push_back(e.cycle);
+            out << ",\n{\"name\":\"in flight\",\"ph\":\"C\",\"ts\":" << e.cycle << ",\"pid\":0,\"args\":{\"transfers\":" << ++inFlight << "}}";
+            break;
+        case EventType::TransferEnd:
+        {
+            deque<int> &starts = transfers[make_tuple(e.core, block, e.a)];
+            if (!starts.empty())
+            {
+                int start = starts.front();
+                starts.pop_front();
+                out << ",\n{\"name\":\"" << (e.a < 3 ? TRANSFER_NAMES[e.a] : "?") << "\",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << e.cycle - start
+                    << ",\"pid\":0,\"tid\":" << (int)e.core << ",\"args\":{\"address\":" << e.address << ",\"bytes\":" << e.arg << "}}";
+                out << ",\n{\"name\":\"in flight\",\"ph\":\"C\",\"ts\":" << e.cycle << ",\"pid\":0,\"args\":{\"transfers\":" << --inFlight << "}}";
+            }
+            if (e.a != EVENT_WRITEBACK && e.core < numCores && stallStart[e.core] >= 0 && stallBlock[e.core] == block)
+            {
+                out << ",\n{\"name\":\"stalled\",\"ph\":\"X\",\"ts\":" << stallStart[e.core] << ",\"dur\":" << e.cycle - stallStart[e.core] << where << "}";
+                stallStart[e.core] = -1;
+            }
+            break;
+        }
+        }
+    }
+    out << "\n]}\n";
+    if (!out)
+    {
+        cerr << "Error: Could not write " << outName << endl;
+        return 1;
+    }
+    cout << "Converted " << records << " events to " << outName << "\n";
+    return 0;
+}
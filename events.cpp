@@ -0,0 +1,49 @@
+#include <iostream>
+#include "events.hpp"
+
+using namespace std;
+
+const size_t EVENT_BUFFER = 1 << 16; // Records per bulk write (1 MB)
+
+EventLog::~EventLog()
+{
+    if (file)
+    {
+        close();
+    }
+}
+
+bool EventLog::open(const string &filename, int numCores, int blockBits)
+{
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+        cerr << "Error: Could not open event file " << filename << endl;
+        return false;
+    }
+    buffer.resize(EVENT_BUFFER);
+    count = 0;
+    failed = fwrite(EVENT_MAGIC, 1, 4, file) != 4 || fwrite(&EVENT_VERSION, 1, 1, file) != 1 ||
+             fwrite(&numCores, sizeof(int), 1, file) != 1 || fwrite(&blockBits, sizeof(int), 1, file) != 1;
+    return !failed;
+}
+
+void EventLog::flush()
+{
+    if (count > 0 && fwrite(buffer.data(), sizeof(EventRecord), count, file) != count)
+    {
+        failed = true;
+    }
+    count = 0;
+}
+
+bool EventLog::close()
+{
+    flush();
+    if (fclose(file) != 0)
+    {
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
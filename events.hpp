@@ -0,0 +1,75 @@
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Binary event log written by L1simulate --events and read by event-convert:
+// the magic "L1EV", a version byte, the core count and block bits (one int
+// each), then fixed-size records in the order they happened.
+static const char EVENT_MAGIC[4] = {'L', '1', 'E', 'V'};
+static const unsigned char EVENT_VERSION = 1;
+
+enum class EventType : unsigned char
+{
+    Issue,         // A core queued a bus request (a = BusReqType, b = EVENT_* flags)
+    Grant,         // The bus granted it (a, b as for Issue; arg = cycles it waited)
+    Snoop,         // A snooping cache held the block (a -> b = its MESIState; arg = requester)
+    Fill,          // The requester's line changed state (a -> b = MESIState)
+    TransferStart, // A transfer went on the bus (a = EVENT_FILL/WRITEBACK/INVALIDATE; arg = cycles)
+    TransferEnd    // It completed (a as for TransferStart; arg = bytes)
+};
+
+// Request flags of Issue and Grant records
+const unsigned char EVENT_MSHR = 1;
+const unsigned char EVENT_PREFETCH = 2;
+const unsigned char EVENT_STORE = 4;
+
+// Transfer kinds
+const unsigned char EVENT_FILL = 0;
+const unsigned char EVENT_WRITEBACK = 1;
+const unsigned char EVENT_INVALIDATE = 2; // BusUpgr invalidation or Dragon update
+
+struct EventRecord
+{
+    int cycle;
+    unsigned int address;
+    int arg;
+    unsigned char type; // EventType
+    unsigned char core;
+    unsigned char a;
+    unsigned char b;
+};
+
+// Recorder of one simulation. Records go into a buffer allocated up front
+// and reach the file in bulk whenever it fills and on close(), so a run
+// without --events only pays for the null check at each call site.
+class EventLog
+{
+public:
+    ~EventLog();
+    bool open(const string &filename, int numCores, int blockBits);
+    void record(EventType type, int cycle, int core, unsigned int address, int a, int b, int arg)
+    {
+        if (count == buffer.size())
+        {
+            flush();
+        }
+        buffer[count++] = EventRecord{cycle, address, arg, (unsigned char)type, (unsigned char)core, (unsigned char)a, (unsigned char)b};
+    }
+    // Writes what is left; false if any write failed
+    bool close();
+
+private:
+    void flush();
+
+    FILE *file = nullptr;
+    vector<EventRecord> buffer;
+    size_t count = 0;
+    bool failed = false;
+};
+
+#endif // EVENTS_HPP
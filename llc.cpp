@@ -0,0 +1,186 @@
+#include <iostream>
+#include "main.hpp"
+#include "cache.hpp"
+
+using namespace std;
+
+const int MEMORY_STALLS = 100; // Bus cycles of a memory access
+
+const char *llcPolicyName(LlcPolicy policy)
+{
+    switch (policy)
+    {
+    case LlcPolicy::Inclusive:
+        return "Inclusive";
+    case LlcPolicy::NonInclusive:
+        return "Non-inclusive";
+    default:
+        return "Exclusive";
+    }
+}
+
+void Simulator::enableLlc(int llcS, int llcE, int llcB, int latency, LlcPolicy policy)
+{
+    llcEnabled = true;
+    this->llcS = llcS;
+    this->llcE = llcE;
+    this->llcB = llcB;
+    llcLatency = latency;
+    llcPolicy = policy;
+    llc.init(llcS, llcB, llcE, replacementPolicy);
+}
+
+// Way of the LLC holding the block of addr, or -1
+int Simulator::llcFind(unsigned int addr)
+{
+    int index = (addr >> llcB) & ((1u << llcS) - 1);
+    unsigned int tag = addr >> (llcS + llcB);
+    CacheLine *set = llc.set(index);
+    for (int j = 0; j < llcE; j++)
+    {
+        if (set[j].state != MESIState::I && set[j].tag == tag)
+        {
+            return j;
+        }
+    }
+    return -1;
+}
+
+// Places the block of addr in the LLC, evicting per the replacement policy.
+// A dirty victim goes to memory; in an inclusive LLC its L1 copies go too.
+void Simulator::llcAllocate(int core, unsigned int addr, bool dirty)
+{
+    int index = (addr >> llcB) & ((1u << llcS) - 1);
+    CacheLine *set = llc.set(index);
+    int way = -1;
+    for (int j = 0; j < llcE; j++)
+    {
+        if (set[j].state == MESIState::I)
+        {
+            way = j;
+            break;
+        }
+    }
+    if (way == -1)
+    {
+        way = llc.victim(index);
+        unsigned int victim = (set[way].tag << (llcS + llcB)) | ((unsigned int)index << llcB);
+        if (llcPolicy == LlcPolicy::Inclusive)
+        {
+            backInvalidate(core, victim);
+        }
+        if (set[way].dirty)
+        {
+            memoryWritebacks++;
+            memoryTrafficBytes[core] += llc.blockSize;
+        }
+    }
+    set[way].tag = addr >> (llcS + llcB);
+    set[way].state = MESIState::E;
+    set[way].dirty = dirty;
+    llc.fill(index, way);
+}
+
+// Invalidates every L1 copy of the L1 blocks inside an evicted LLC block.
+// Modified data is written straight to memory.
+void Simulator::backInvalidate(int core, unsigned int addr)
+{
+    for (unsigned int offset = 0; offset < (1u << llcB); offset += 1u << b)
+    {
+        int l1addr = addr + offset;
+        int index = (l1addr >> b) & ((1 << s) - 1);
+        int tag = l1addr >> (s + b);
+        unsigned int block = blockAddress(index, tag);
+        unsigned long long sharers = dirSharers(block);
+        for (int i = 0; sharers; i++, sharers >>= 1)
+        {
+            if (!(sharers & 1))
+            {
+                continue;
+            }
+            CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+            if (line.state == MESIState::M || line.state == MESIState::O)
+            {
+                memoryWritebacks++;
+                memoryTrafficBytes[core] += caches[i].blockSize;
+            }
+            line.state = MESIState::I;
+            prefetchLost(i, line, false);
+            dirRemove(block, i);
+            llcBackInvalidations[i]++;
+        }
+    }
+}
+
+int Simulator::fetchStalls(int core, int addr)
+{
+    if (!llcEnabled)
+    {
+        return MEMORY_STALLS;
+    }
+    int way = llcFind(addr);
+    if (way != -1)
+    {
+        llcHits[core]++;
+        int index = ((unsigned int)addr >> llcB) & ((1u << llcS) - 1);
+        CacheLine &line = llc.set(index)[way];
+        if (llcPolicy == LlcPolicy::Exclusive)
+        {
+            // The block moves up to the L1, which fills it clean
+            if (line.dirty)
+            {
+                memoryWritebacks++;
+                memoryTrafficBytes[core] += llc.blockSize;
+            }
+            line.state = MESIState::I;
+            line.dirty = false;
+        }
+        else
+        {
+            llc.touch(index, way);
+        }
+        return llcLatency;
+    }
+    llcMisses[core]++;
+    memoryTrafficBytes[core] += llc.blockSize;
+    if (llcPolicy != LlcPolicy::Exclusive)
+    {
+        llcAllocate(core, addr, false);
+    }
+    return llcLatency + MEMORY_STALLS;
+}
+
+int Simulator::writebackStalls(int core, int addr, bool keep)
+{
+    if (!llcEnabled)
+    {
+        return MEMORY_STALLS;
+    }
+    if (llcPolicy == LlcPolicy::Exclusive && keep)
+    {
+        // The L1 keeps its (now clean) copy, so the data goes to memory
+        memoryWritebacks++;
+        memoryTrafficBytes[core] += caches[core].blockSize;
+        return MEMORY_STALLS;
+    }
+    int way = llcFind(addr);
+    if (way != -1)
+    {
+        int index = ((unsigned int)addr >> llcB) & ((1u << llcS) - 1);
+        llc.set(index)[way].dirty = true;
+        llc.touch(index, way);
+    }
+    else
+    {
+        llcAllocate(core, addr, true);
+    }
+    return llcLatency;
+}
+
+void Simulator::cleanEviction(int core, int addr)
+{
+    if (llcEnabled && llcPolicy == LlcPolicy::Exclusive && llcFind(addr) == -1)
+    {
+        llcAllocate(core, addr, false);
+    }
+}
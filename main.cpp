@@ -6,207 +6,413 @@
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <climits>
 #include <fstream>
+#include <memory>
+#include <chrono>
+#include <sys/resource.h>
 #include "main.hpp"
 #include "bus.hpp"
 #include "cache.hpp"
+#include "trace.hpp"
+#include "sweep.hpp"
+#include "profile.hpp"
+#include "parallel.hpp"
+#include "sample.hpp"
 
 using namespace std;
 
-// Define global variables declared as external in other files
+// Command line configuration, copied into each Simulator
 int s = 2; // Default values, will be overridden by command line arguments
 int b = 4;
 int E = 2;
+int numCores = 4;
+ReplPolicy replacementPolicy = ReplPolicy::LRU;
+Protocol protocol = Protocol::MESI;
 
-// Define global data structures
-vector<BusReq> busQueue;
-set<int> curr_write;
-vector<BusData> busDataQueue;
-vector<int> clockCycles;
-vector<int> instructions;
-Cache caches[4];
-vector<vector<MESIState>> mesiState[4];
-
-// Define trace vectors as global variables
-vector<pair<char, const char *>> trace1;
-vector<pair<char, const char *>> trace2;
-vector<pair<char, const char *>> trace3;
-vector<pair<char, const char *>> trace4;
-
-vector<int> num_reads(4, 0);
-vector<int> num_writes(4, 0);
-vector<int> cache_misses(4, 0);
-vector<int> cache_evictions(4, 0);
-vector<int> writebacks(4, 0);
-vector<int> bus_invalidations(4, 0);
-vector<long long> data_traffic_bytes(4, 0);
-vector<int> idle_cycles(4, 0);
-int total_bus_transactions = 0;
-long long total_bus_traffic_bytes = 0;
-
-vector<bool> coreActive(4, true);
-
-// Function to load trace files based on prefix
+// Event-driven kernel (--event): jump over cycles in which every core is
+// blocked and the bus is only counting down a transfer.
+bool eventDriven = false;
+
+// Parallel kernel (--parallel): threads that run the cores' hit streaks
+// between coherence events; 0 runs everything on one thread.
+int parallelThreads = 0;
+
+// Shared last-level cache (--llc s:E:b), off when llcSpec is empty
+string llcSpec;
+int llcLatency = 20;
+LlcPolicy llcPolicy = LlcPolicy::Inclusive;
+
+// Split-transaction bus (--split n): transfers that may be in flight at once
+int splitOutstanding = 0;
+
+// Non-blocking caches (--mshr n): misses each core may have outstanding
+int mshrCount = 0;
+
+// Per-core hardware prefetcher (--prefetch kind[:n])
+PrefetchKind prefetcher = PrefetchKind::None;
+int prefetchDegree = 0;
+
+// Per-core store buffer (--store-buffer n): writes it holds at most
+int storeBufferDepth = 0;
+
+// Binary event log of the bus transactions (--events file), off when empty
+string eventsFile;
+
+// False-sharing analysis (--sharing [n]): lines to list, 0 when off
+int sharingTop = 0;
+
+// Miss classification (--classify [file]); the per-set histogram goes to
+// setHistogramFile when one is given
+bool classifyMisses = false;
+string setHistogramFile;
+
+// Report load and simulation wall time, throughput and peak RSS (--timing)
+bool printTiming = false;
+
+// Decoded traces, one per core, shared read-only by every simulation
+vector<vector<TraceAccess>> traces;
+
+// Streaming trace sources, used instead of traces with --stream
+bool streamTraces = false;
+size_t streamChunk = 1 << 16; // Decoded accesses per chunk
+vector<unique_ptr<TraceStream>> traceStreams;
+
+// Function to load trace files based on prefix. A binary trace set
+// (<prefix>.btr, see trace-convert) is used when present, otherwise the
+// text files <prefix>_proc0.trace .. <prefix>_proc{n-1}.trace.
 bool loadTraceFiles(const string &tracePrefix)
 {
-    vector<vector<pair<char, const char *>> *> traces = {&trace1, &trace2, &trace3, &trace4};
+    traces.assign(numCores, vector<TraceAccess>());
 
-    for (int i = 0; i < 4; i++)
+    string binaryName = tracePrefix + BTRACE_EXTENSION;
+    if (isBinaryTrace(tracePrefix))
     {
-        // Construct filename: app1_proc0.trace, app1_proc1.trace, etc.
-        string filename = tracePrefix + "_proc" + to_string(i) + ".trace";
-        ifstream traceFile(filename);
-
-        if (!traceFile.is_open())
+        binaryName = tracePrefix;
+    }
+    if (isBinaryTrace(binaryName))
+    {
+        vector<vector<TraceAccess>> cores;
+        if (!readBinaryTrace(binaryName, cores))
         {
-            cerr << "Error: Could not open trace file " << filename << endl;
             return false;
         }
+        if ((int)cores.size() < numCores)
+        {
+            cerr << "Error: " << binaryName << " holds " << cores.size() << " cores, " << numCores << " are required" << endl;
+            return false;
+        }
+        if (streamTraces)
+        {
+            cerr << "Note: --stream applies to text traces only, loading " << binaryName << " into memory" << endl;
+            streamTraces = false;
+        }
+        for (int i = 0; i < numCores; i++)
+        {
+            traces[i].swap(cores[i]);
+        }
+        return true;
+    }
 
-        // Clear any existing data
-        traces[i]->clear();
-
-        string line;
-        while (getline(traceFile, line))
+    traceStreams.clear();
+    for (int i = 0; i < numCores; i++)
+    {
+        // Construct filename: app1_proc0.trace, app1_proc1.trace, etc.
+        string filename = tracePrefix + "_proc" + to_string(i) + ".trace";
+        if (streamTraces)
         {
-            // Skip empty lines or comments
-            if (line.empty() || line[0] == '#')
+            // Decoded lazily by a background thread during simulation
+            traceStreams.emplace_back(new TraceStream());
+            if (!traceStreams[i]->open(filename, streamChunk))
             {
-                continue;
+                return false;
             }
+            continue;
+        }
+        if (!loadTextTrace(filename, traces[i]))
+        {
+            return false;
+        }
+    }
 
-            // Parse line like "R 0x817b08"
-            istringstream iss(line);
-            char op;
-            string address;
+    return true;
+}
 
-            if (iss >> op >> address)
+Simulator::Simulator(int s, int b, int E, int numCores, ReplPolicy replacementPolicy)
+    : s(s), b(b), E(E), numCores(numCores), replacementPolicy(replacementPolicy),
+      protocol(Protocol::MESI), eventDriven(false), parallelThreads(0), mshrCount(0), prefetcher(PrefetchKind::None), prefetchDegree(0), storeBufferDepth(0), events(nullptr), sharingTop(0), classifyMisses(false), llcEnabled(false), llcS(0), llcE(0), llcB(0), llcLatency(0), llcPolicy(LlcPolicy::NonInclusive),
+      checkpointAt(0), checkpointByAccesses(false), traces(nullptr), streams(nullptr),
+      busQueue(numCores), busDataQueue(16), bus_busy(false), splitOutstanding(0), cycle(0), cycle2(0),
+      globalCycle(0), maxtime(0), total_bus_transactions(0), total_bus_traffic_bytes(0),
+      busQueueDepthSum(0), busWaitCycles(0), busGrants(0), busMaxWait(0), busBusyCycles(0),
+      busConflicts(0), memoryWritebacks(0)
+{
+    // Initialize caches (all lines start in the I state)
+    caches.assign(numCores, Cache());
+    for (int i = 0; i < numCores; ++i)
+    {
+        caches[i].init(s, b, E, replacementPolicy);
+    }
+
+    // Initialize simulation counters and per-core bus state
+    instructions.assign(numCores, 0);
+    clockCycles.assign(numCores, 0);
+    num_reads.assign(numCores, 0);
+    num_writes.assign(numCores, 0);
+    cache_misses.assign(numCores, 0);
+    cache_evictions.assign(numCores, 0);
+    writebacks.assign(numCores, 0);
+    bus_invalidations.assign(numCores, 0);
+    bus_updates.assign(numCores, 0);
+    data_traffic_bytes.assign(numCores, 0);
+    idle_cycles.assign(numCores, 0);
+    coreActive.assign(numCores, true);
+    corePendingOperation.assign(numCores, -1);
+    waitingForBus.assign(numCores, false);
+    tracePos.assign(numCores, 0);
+    llcHits.assign(numCores, 0);
+    llcMisses.assign(numCores, 0);
+    llcBackInvalidations.assign(numCores, 0);
+    memoryTrafficBytes.assign(numCores, 0);
+    mshrAllocations.assign(numCores, 0);
+    mshrMerges.assign(numCores, 0);
+    mshrFullCycles.assign(numCores, 0);
+    mshrOccupancy.assign(numCores, 0);
+    mshrPeak.assign(numCores, 0);
+    prefetchTrainers.assign(numCores, PrefetchTrainer{});
+    prefetchPending.assign(numCores, vector<PrefetchPending>());
+    prefetchIssued.assign(numCores, 0);
+    prefetchUseful.assign(numCores, 0);
+    prefetchLate.assign(numCores, 0);
+    prefetchUseless.assign(numCores, 0);
+    prefetchInvalidated.assign(numCores, 0);
+    prefetchTrafficBytes.assign(numCores, 0);
+    storeBuffers.assign(numCores, vector<int>());
+    storeInFlight.assign(numCores, false);
+    storesBuffered.assign(numCores, 0);
+    storeForwards.assign(numCores, 0);
+    storeFullCycles.assign(numCores, 0);
+    storeOccupancy.assign(numCores, 0);
+    storePeak.assign(numCores, 0);
+    sharingTouches.assign(numCores, unordered_map<unsigned int, SharingTouch>());
+    hitWays.assign(numCores, vector<int>());
+}
+
+// Returns the access at position pos of a core's trace, or nullptr past its end
+const TraceAccess *Simulator::traceAt(int core, size_t pos)
+{
+    if (streams)
+    {
+        return (*streams)[core]->get(pos);
+    }
+    const vector<TraceAccess> &trace = (*traces)[core];
+    return pos < trace.size() ? &trace[pos] : nullptr;
+}
+
+void Simulator::skipCycles(int span)
+{
+    for (int i = 0; i < numCores; i++)
+    {
+        if (coreActive[i])
+        {
+            cycle2 += span;
+            if (corePendingOperation[i] != -1)
             {
-                // Only process read (R) and write (W) operations
-                if (op == 'R' || op == 'W')
-                {
-                    // We need to create a persistent copy of the address string
-                    char *addressCopy = new char[address.length() + 1];
-                    strcpy(addressCopy, address.c_str());
-                    traces[i]->push_back({op, addressCopy});
-                }
+                clockCycles[i] += span;
             }
         }
-
-        traceFile.close();
     }
-
-    return true;
+    busSkip(span);
+    if (mshrCount > 0)
+    {
+        mshrTick(span);
+    }
+    if (storeBufferDepth > 0)
+    {
+        storeTick(span);
+    }
+    globalCycle += span;
+    maxtime = max(maxtime, globalCycle);
 }
 
-void simulateMulticore()
+// One cycle of the simulation (or, with --event / --parallel, a run of cycles
+// handled in bulk). Returns false once every core and the bus are done.
+bool Simulator::step(CoreWorkers *workers)
 {
-    // Initialize counters for trace position for each core
-    vector<size_t> tracePos(4, 0);
-
-    // References to the trace vectors for easier access
-    const vector<vector<pair<char, const char *>>> traces = {
-        trace1, trace2, trace3, trace4};
+    if (workers && hitWindow(*workers) > 0)
+    {
+        return true;
+    }
+    if (eventDriven)
+    {
+        // The next event is either the end of the current bus countdown
+        // or a core that can run; skip straight to it if it is the former.
+        int span = storesQuiet() ? busQuietCycles() : 0;
+        for (int i = 0; i < numCores && span > 0; i++)
+        {
+            if (coreActive[i] && !(caches[i].stall && (corePendingOperation[i] != -1 || waitingForBus[i])))
+            {
+                span = 0;
+            }
+        }
+        if (span > 0)
+        {
+            skipCycles(span);
+            return true;
+        }
+    }
 
-    // Track if each core has more instructions
+    //  Process each core in round-robin fashion
+    for (int i = 0; i < numCores; i++)
+    {
+        // Skip cores that have completed their trace
+        if (!coreActive[i])
+        {
+            continue;
+        }
 
-    // Main simulation loop
-    bool simActive = true;
-    int globalCycle = 0;
-    int maxtime = 0;
+        // Skip stalled cores without incrementing their position
+        // Check if there are more instructions for this core
+        const TraceAccess *currentOp = traceAt(i, tracePos[i]);
+        if (currentOp)
+        {
+            // Get the current operation for this core
+            // Execute the operation
+            run(*currentOp, i);
+        }
+        else
+        {
+            coreActive[i] = false;
+        }
+    }
 
-    while (simActive)
+    // Store buffers drain even after their cores have finished
+    if (storeBufferDepth > 0)
     {
-        if (globalCycle % 100000 == 0)
+        for (int i = 0; i < numCores; i++)
         {
-            // cout << coreActive[0] << " " << coreActive[1] << " " << coreActive[2] << " " << coreActive[3] << endl;
+            storeDrain(i);
         }
-        // cout << coreActive[0] << " " << coreActive[1] << " " << coreActive[2] << " " << coreActive[3] << endl;
-        // cout << globalCycle << endl;
-        //  Process each core in round-robin fashion
-        for (int i = 0; i < 4; i++)
+    }
+
+    bus();
+    if (mshrCount > 0)
+    {
+        mshrTick(1);
+    }
+    if (storeBufferDepth > 0)
+    {
+        storeTick(1);
+    }
+
+    for (int i = 0; i < numCores; i++)
+    {
+
+        if (!caches[i].stall && coreActive[i])
         {
-            // Skip cores that have completed their trace
-            if (!coreActive[i])
+            if (sharingTop > 0)
             {
-                continue;
+                sharingAccess(i, *traceAt(i, tracePos[i]));
             }
-
-            // Skip stalled cores without incrementing their position
-            // Check if there are more instructions for this core
-            if (tracePos[i] < traces[i].size())
+            // A store that went into the store buffer reaches the cache,
+            // and the shadow cache, when it drains
+            if (classifyMisses && !(traceAt(i, tracePos[i])->write && !storeBuffers[i].empty()))
             {
-                // Get the current operation for this core
-                pair<char, const char *> currentOp = traces[i][tracePos[i]];
-                // Execute the operation
-                if (globalCycle % 100000 == 0)
-                {
-                    // cout << "Core " << i << " Cycle: " << globalCycle << ", Instruction: " << tracePos[i] << endl;
-                }
-                run(currentOp, i);
+                classifyAccess(i, *traceAt(i, tracePos[i]));
             }
-            else
+            tracePos[i]++;
+            instructions[i]++;
+            if (!traceAt(i, tracePos[i]))
             {
-                coreActive[i] = false;
-                // cout << i << endl;
+                coreActive[i] = false; // Mark core as inactive if all instructions are executed
             }
         }
+    }
+    // Check if simulation should continue
+    bool simActive = false;
+    for (int i = 0; i < numCores; i++)
+    {
+        // Simulation continues if any core has more operations or is stalled,
+        // or misses of a non-blocking cache or buffered stores are still
+        // queued or in flight
+        if (coreActive[i] || caches[i].stall || !busQueue.empty() || !busDataQueue.empty() || !storeBuffers[i].empty())
+        {
+            simActive = true;
+            break;
+        }
+    }
 
-        bus();
+    globalCycle++;
+    maxtime = max(maxtime, globalCycle);
+    return simActive;
+}
 
-        for (int i = 0; i < 4; i++)
-        {
+void Simulator::simulate()
+{
+    // Main simulation loop
+    unique_ptr<CoreWorkers> workers;
+    if (parallelThreads > 0 && !streams)
+    {
+        workers.reset(new CoreWorkers(min(parallelThreads, numCores)));
+    }
 
-            if (!caches[i].stall && coreActive[i])
+    while (step(workers.get()))
+    {
+        if (!checkpointFile.empty())
+        {
+            long long reached = globalCycle;
+            if (checkpointByAccesses)
             {
-                tracePos[i]++;
-                instructions[i]++;
-                if (tracePos[i] == traces[i].size())
-                {
-                    coreActive[i] = false; // Mark core as inactive if all instructions are executed
-                }
+                reached = 0;
+                for (int i = 0; i < numCores; i++)
+                    reached += instructions[i];
             }
-        }
-        // Check if simulation should continue
-        simActive = false;
-        for (int i = 0; i < 4; i++)
-        {
-            // Simulation continues if any core has more operations or is stalled
-            if (coreActive[i] || caches[i].stall || !busDataQueue.empty())
+            if (reached >= checkpointAt)
             {
-                simActive = true;
-                break;
+                if (saveCheckpoint(checkpointFile))
+                    checkpointFile.clear();
+                else
+                    checkpointAt = LLONG_MAX; // Do not retry; main() reports it
             }
         }
-
-        globalCycle++;
-        maxtime = max(maxtime, globalCycle);
     }
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < numCores; i++)
     {
-        // Update the clock cycles for each core
-        for (int j = 0; j < traces[i].size(); j++)
+        // Count reads and writes for each core
+        if (streams)
+        {
+            num_reads[i] = (*streams)[i]->reads();
+            num_writes[i] = (*streams)[i]->writes();
+            continue;
+        }
+        const vector<TraceAccess> &trace = (*traces)[i];
+        for (size_t j = 0; j < trace.size(); j++)
         {
-            if (traces[i][j].first == 'R')
+            if (trace[j].write)
             {
-                num_reads[i]++;
+                num_writes[i]++;
             }
-            else if (traces[i][j].first == 'W')
+            else
             {
-                num_writes[i]++;
+                num_reads[i]++;
             }
         }
     }
+}
+
+void Simulator::printResults(ostream &out)
+{
     // Print final statistics
-    cout << "\n===== Simulation Results =====\n";
-    cout << "Total simulation cycles: " << globalCycle - 1 << endl;
+    out << "\n===== Simulation Results =====\n";
+    out << "Total simulation cycles: " << globalCycle - 1 << endl;
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < numCores; i++)
     {
-        cout << "Core " << i << ":\n";
-        cout << "  Instructions executed: " << instructions[i] << endl;
-        cout << endl;
+        out << "Core " << i << ":\n";
+        out << "  Instructions executed: " << instructions[i] << endl;
+        out << endl;
         // maxtime = max(maxtime, clockCycles[i]);
     }
     string trace_prefix = "app"; // Replace with tracefile from command-line if available
@@ -214,59 +420,218 @@ void simulateMulticore()
     int num_sets = 1 << s;
     double cache_size_kb = (num_sets * E * block_size) / 1024.0;
 
-    cout << "Simulation Parameters:\n";
-    cout << "Trace Prefix: " << trace_prefix << "\n";
-    cout << "Set Index Bits: " << s << "\n";
-    cout << "Associativity: " << E << "\n";
-    cout << "Block Bits: " << b << "\n";
-    cout << "Block Size (Bytes): " << block_size << "\n";
-    cout << "Number of Sets: " << num_sets << "\n";
-    cout << fixed << setprecision(2) << "Cache Size (KB per core): " << cache_size_kb << "\n";
-    cout << "MESI Protocol: Enabled\n";
-    cout << "Write Policy: Write-back, Write-allocate\n";
-    cout << "Replacement Policy: LRU\n";
-    cout << "Bus: Central snooping bus\n\n";
-
-    for (int i = 0; i < 4; i++)
-    {
-        cout << "Core " << i << " Statistics:\n";
-        cout << "Total Instructions: " << instructions[i] << "\n";
-        cout << "Total Reads: " << num_reads[i] << "\n";
-        cout << "Total Writes: " << num_writes[i] << "\n";
-        cout << "Total Execution Cycles: " << clockCycles[i] + instructions[i] << "\n";
-        cout << "Idle Cycles: " << (idle_cycles[i]) << "\n";
-        cout << "Cache Misses: " << cache_misses[i] << "\n";
+    out << "Simulation Parameters:\n";
+    out << "Trace Prefix: " << trace_prefix << "\n";
+    out << "Number of Cores: " << numCores << "\n";
+    out << "Set Index Bits: " << s << "\n";
+    out << "Associativity: " << E << "\n";
+    out << "Block Bits: " << b << "\n";
+    out << "Block Size (Bytes): " << block_size << "\n";
+    out << "Number of Sets: " << num_sets << "\n";
+    out << fixed << setprecision(2) << "Cache Size (KB per core): " << cache_size_kb << "\n";
+    out << protocolName(protocol) << " Protocol: Enabled\n";
+    out << "Write Policy: Write-back, Write-allocate\n";
+    if (mshrCount > 0)
+    {
+        out << "Non-blocking Cache: " << mshrCount << " MSHRs per core\n";
+    }
+    if (prefetcher != PrefetchKind::None)
+    {
+        out << "Prefetcher: " << prefetchKindName(prefetcher) << " (degree " << prefetchDegree << ")\n";
+    }
+    if (storeBufferDepth > 0)
+    {
+        out << "Store Buffer: " << storeBufferDepth << " entries per core\n";
+    }
+    out << "Replacement Policy: " << replPolicyName(replacementPolicy) << "\n";
+    if (replacementPolicy != ReplPolicy::LRU)
+    {
+        out << "Replacement State (bits per set): " << replStateBits(replacementPolicy, E) << "\n";
+        if (replCacheStateBits(replacementPolicy) > 0)
+        {
+            out << "Replacement State (bits per cache): " << replCacheStateBits(replacementPolicy) << "\n";
+        }
+    }
+    out << "Bus: Central snooping bus";
+    if (splitOutstanding > 0)
+    {
+        out << ", split-transaction (" << splitOutstanding << " outstanding)";
+    }
+    out << "\n\n";
+
+    for (int i = 0; i < numCores; i++)
+    {
+        out << "Core " << i << " Statistics:\n";
+        out << "Total Instructions: " << instructions[i] << "\n";
+        out << "Total Reads: " << num_reads[i] << "\n";
+        out << "Total Writes: " << num_writes[i] << "\n";
+        out << "Total Execution Cycles: " << clockCycles[i] + instructions[i] << "\n";
+        out << "Idle Cycles: " << (idle_cycles[i]) << "\n";
+        out << "Cache Misses: " << cache_misses[i] << "\n";
         double miss_rate = (num_reads[i] + num_writes[i] > 0) ? (cache_misses[i] * 100.0) / (num_reads[i] + num_writes[i]) : 0.0;
-        cout << fixed << setprecision(5) << "Cache Miss Rate: " << miss_rate << "%\n";
-        cout << "Cache Evictions: " << cache_evictions[i] << "\n";
-        cout << "Writebacks: " << writebacks[i] << "\n";
-        cout << "Bus Invalidations: " << bus_invalidations[i] << "\n";
-        cout << "Data Traffic (Bytes): " << data_traffic_bytes[i] << "\n\n";
+        out << fixed << setprecision(5) << "Cache Miss Rate: " << miss_rate << "%\n";
+        if (classifyMisses)
+        {
+            for (int k = 0; k < MISS_CLASSES; k++)
+            {
+                out << missClassName((MissClass)k) << " Misses: " << missClassifiers[i].counts[k] << "\n";
+            }
+        }
+        out << "Cache Evictions: " << cache_evictions[i] << "\n";
+        out << "Writebacks: " << writebacks[i] << "\n";
+        out << "Bus Invalidations: " << bus_invalidations[i] << "\n";
+        if (protocol == Protocol::Dragon)
+        {
+            out << "Bus Updates: " << bus_updates[i] << "\n";
+        }
+        out << "Data Traffic (Bytes): " << data_traffic_bytes[i] << "\n";
+        if (mshrCount > 0)
+        {
+            out << "MSHR Allocations: " << mshrAllocations[i] << "\n";
+            out << "MSHR Merges: " << mshrMerges[i] << "\n";
+            out << "Average MSHR Occupancy: " << (maxtime > 0 ? (double)mshrOccupancy[i] / maxtime : 0.0) << "\n";
+            out << "Peak MSHR Occupancy: " << mshrPeak[i] << "\n";
+            out << "MSHR Full Stall Cycles: " << mshrFullCycles[i] << "\n";
+        }
+        if (prefetcher != PrefetchKind::None)
+        {
+            // Accuracy: prefetches the core used; coverage: misses they removed
+            long long used = prefetchUseful[i] + prefetchLate[i];
+            out << "Prefetches Issued: " << prefetchIssued[i] << "\n";
+            out << "Useful Prefetches: " << prefetchUseful[i] << "\n";
+            out << "Late Prefetches: " << prefetchLate[i] << "\n";
+            out << "Useless Prefetches: " << prefetchUseless[i] << "\n";
+            out << "Prefetched Lines Invalidated: " << prefetchInvalidated[i] << "\n";
+            out << "Prefetch Traffic (Bytes): " << prefetchTrafficBytes[i] << "\n";
+            out << "Prefetch Accuracy: " << (prefetchIssued[i] > 0 ? used * 100.0 / prefetchIssued[i] : 0.0) << "%\n";
+            out << "Prefetch Coverage: " << (used + cache_misses[i] > 0 ? used * 100.0 / (used + cache_misses[i]) : 0.0) << "%\n";
+        }
+        if (storeBufferDepth > 0)
+        {
+            out << "Buffered Stores: " << storesBuffered[i] << "\n";
+            out << "Store-to-Load Forwards: " << storeForwards[i] << "\n";
+            out << "Average Store Buffer Occupancy: " << (maxtime > 0 ? (double)storeOccupancy[i] / maxtime : 0.0) << "\n";
+            out << "Peak Store Buffer Occupancy: " << storePeak[i] << "\n";
+            out << "Store Buffer Full Stall Cycles: " << storeFullCycles[i] << "\n";
+        }
+        if (replacementPolicy != ReplPolicy::LRU)
+        {
+            out << "Fills Into Invalid Lines: " << caches[i].invalidFills << "\n";
+            out << "Victim Search Steps: " << caches[i].searchSteps << "\n";
+        }
+        out << "\n";
+    }
+
+    if (llcEnabled)
+    {
+        out << "Shared LLC Statistics:\n";
+        out << "LLC Set Index Bits: " << llcS << "\n";
+        out << "LLC Associativity: " << llcE << "\n";
+        out << "LLC Block Bits: " << llcB << "\n";
+        out << fixed << setprecision(2) << "LLC Size (KB): " << ((double)llc.sets * llcE * llc.blockSize) / 1024.0 << "\n";
+        out << "LLC Hit Latency (cycles): " << llcLatency << "\n";
+        out << "LLC Inclusion Policy: " << llcPolicyName(llcPolicy) << "\n";
+        long long memoryTraffic = 0;
+        for (int i = 0; i < numCores; i++)
+        {
+            long long lookups = llcHits[i] + llcMisses[i];
+            out << "Core " << i << " LLC Hits: " << llcHits[i] << ", LLC Misses: " << llcMisses[i]
+                << ", LLC Miss Rate: " << (lookups > 0 ? llcMisses[i] * 100.0 / lookups : 0.0) << "%"
+                << ", Back-Invalidations: " << llcBackInvalidations[i]
+                << ", Memory Traffic (Bytes): " << memoryTrafficBytes[i] << "\n";
+            memoryTraffic += memoryTrafficBytes[i];
+        }
+        out << "Memory Writebacks: " << memoryWritebacks << "\n";
+        out << "Total Memory Traffic (Bytes): " << memoryTraffic << "\n\n";
     }
 
-    cout << "Overall Bus Summary:\n";
-    cout << "Total Bus Transactions: " << total_bus_transactions << "\n";
-    cout << "Total Bus Traffic (Bytes): " << total_bus_traffic_bytes << "\n";
+    out << "Overall Bus Summary:\n";
+    out << "Total Bus Transactions: " << total_bus_transactions << "\n";
+    out << "Total Bus Traffic (Bytes): " << total_bus_traffic_bytes << "\n";
+    out << fixed << setprecision(2) << "Bus Utilization: " << (globalCycle > 0 ? busBusyCycles * 100.0 / globalCycle : 0.0) << "%\n";
+    out << "Max Bus Request Queue Depth: " << busQueue.highWater << "\n";
+    out << fixed << setprecision(2) << "Average Bus Request Queue Depth: " << (globalCycle > 0 ? (double)busQueueDepthSum / globalCycle : 0.0) << "\n";
+    out << "Average Bus Wait (cycles): " << (busGrants > 0 ? (double)busWaitCycles / busGrants : 0.0) << "\n";
+    out << "Max Bus Wait (cycles): " << busMaxWait << "\n";
+    out << "Max Bus Data Queue Depth: " << busDataQueue.highWater << "\n";
+    if (splitOutstanding > 0)
+    {
+        out << "Same-Block Conflict Stalls (request-cycles): " << busConflicts << "\n";
+    }
 
-    cout << "Maximum Execution Time (cycles): " << maxtime << "\n";
+    out << "Maximum Execution Time (cycles): " << maxtime << "\n";
+    if (sharingTop > 0)
+    {
+        printSharing(out);
+    }
 }
 
 void printUsage(const char *progName)
 {
     cout << "Usage: " << progName << " -t <tracefile> -s <s> -E <E> -b <b> [-o <outfilename>] [-h]\n"
          << "\nOptions:\n"
-         << "  -t <tracefile>  Name of the parallel application (e.g. app1) whose 4 traces are\n"
-         << "                  to be used in simulation.\n"
+         << "  -t <tracefile>  Name of the parallel application (e.g. app1) whose per-core\n"
+         << "                  traces are to be used in simulation.\n"
+         << "  -n <cores>      Number of cores (default 4, at most 64); reads _proc0 .. _proc{n-1}.\n"
          << "  -s <s>          Number of set index bits (number of sets in the cache = S = 2^s).\n"
          << "  -E <E>          Associativity (number of cache lines per set).\n"
          << "  -b <b>          Number of block bits (block size = B = 2^b).\n"
          << "  -o <outfilename>Log output in file for plotting etc.\n"
+         << "  -r <policy>     Replacement policy: lru (default), plru, srrip, brrip, random.\n"
+         << "  -p <protocol>   Coherence protocol: mesi (default), moesi, mesif, dragon.\n"
+         << "  --sweep <spec>  Run many (s, E, b) points in parallel on the loaded traces and\n"
+         << "                  write one CSV table (JSON if -o ends in .json). <spec> is a file\n"
+         << "                  or inline groups like \"s=1:11 E=2 b=5; s=6 E=1:100 b=5\".\n"
+         << "  -j <threads>    Worker threads for --sweep (default: all hardware threads).\n"
+         << "  --profile [maxE]Functional LRU stack-distance profile for the given -s/-b: miss\n"
+         << "                  ratio of every associativity 1..maxE (default 128) and of fully\n"
+         << "                  associative caches, in one pass. Ignores coherence.\n"
+         << "  --sample <i[:w[:u]]> Sampled simulation: in every i accesses per core, warm the\n"
+         << "                  caches functionally, then simulate u (default 500) in detail\n"
+         << "                  and measure the next w (default 1000). Prints estimates of\n"
+         << "                  cycles, miss rate and bus traffic with 95% confidence intervals.\n"
+         << "  --checkpoint <file> <n>  Save the complete simulator state once cycle n (or, as\n"
+         << "                  <n>a, n accesses retired by all cores) is reached.\n"
+         << "  --restore <file> Resume from a checkpoint taken with the same options and traces.\n"
+         << "  --llc <s:E:b>   Shared last-level cache between the bus and memory.\n"
+         << "  --llc-latency <n> LLC hit latency in bus cycles (default 20; memory takes 100).\n"
+         << "  --llc-policy <p> inclusive (default, with back-invalidation), non-inclusive\n"
+         << "                  or exclusive (LLC b equal to -b).\n"
+         << "  --split [n]     Split-transaction bus with up to n transfers in flight\n"
+         << "                  (default 4); requests for a block in flight wait.\n"
+         << "  --mshr <n>      Non-blocking caches: up to n outstanding misses per core;\n"
+         << "                  hits and misses to the same block go on under a miss.\n"
+         << "  --events <file>  Record bus requests, grants, snoops, fills and transfers\n"
+         << "                  to a binary log (see event-convert).\n"
+         << "  --store-buffer <n> Per-core FIFO of n stores drained in the background;\n"
+         << "                  reads of a buffered address are forwarded from it.\n"
+         << "  --prefetch <p>  Per-core prefetcher: next[:n], stride[:n] or stream[:n]\n"
+         << "                  (n blocks ahead; default 1, or 4 for stream).\n"
+         << "  --sharing [n]   False-sharing analysis: per-line ownership ping-pong and the\n"
+         << "                  offsets each core touched; lists the top n lines (default 10).\n"
+         << "  --classify [file] Split each core's misses into compulsory, capacity, conflict\n"
+         << "                  and coherence; write per-set misses and evictions as CSV.\n"
+         << "  --timing        Print trace load and simulation wall time, accesses and\n"
+         << "                  cycles simulated per second and peak RSS to stderr.\n"
+         << "  --event         Event-driven kernel: skip cycles in which all cores wait on\n"
+         << "                  the bus (same results as the default cycle-by-cycle kernel).\n"
+         << "  --parallel [n]  Run the cores' cache hits between coherence events on n threads\n"
+         << "                  (default: one per core); same results as the serial kernel.\n"
+         << "  --stream [n]    Stream traces from disk in chunks of n accesses (default 65536)\n"
+         << "                  instead of loading them into memory up front.\n"
          << "  -h              Print this help message.\n";
 }
 
 int main(int argc, char *argv[])
 {
     string tracePrefix;
+    string sweepSpec;
+    int sweepThreads = 0; // 0 = one per hardware thread
+    int profileMaxE = 0;  // --profile: largest associativity to report
+    string sampleSpec;    // --sample: interval[:window[:warmup]]
+    string checkpointFile;  // --checkpoint: file to write and when
+    string checkpointPoint;
+    string restoreFile;     // --restore: checkpoint to resume from
     string outfilename;
 
     // Parse command line arguments
@@ -313,6 +678,23 @@ int main(int argc, char *argv[])
                 return 1;
             }
         }
+        else if (strcmp(argv[i], "-n") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                numCores = atoi(argv[++i]);
+                if (numCores < 1 || numCores > MAX_CORES)
+                {
+                    cerr << "Error: Number of cores must be between 1 and " << MAX_CORES << ".\n";
+                    return 1;
+                }
+            }
+            else
+            {
+                cerr << "Error: Missing argument for -n option.\n";
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "-b") == 0)
         {
             if (i + 1 < argc)
@@ -339,6 +721,272 @@ int main(int argc, char *argv[])
             }
             cout << "Output file name: " << argv[i] << endl;
         }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                string policy = argv[++i];
+                if (policy == "lru")
+                    replacementPolicy = ReplPolicy::LRU;
+                else if (policy == "plru")
+                    replacementPolicy = ReplPolicy::PLRU;
+                else if (policy == "srrip")
+                    replacementPolicy = ReplPolicy::SRRIP;
+                else if (policy == "brrip")
+                    replacementPolicy = ReplPolicy::BRRIP;
+                else if (policy == "random")
+                    replacementPolicy = ReplPolicy::Random;
+                else
+                {
+                    cerr << "Error: Unknown replacement policy " << policy << ".\n";
+                    return 1;
+                }
+            }
+            else
+            {
+                cerr << "Error: Missing argument for -r option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                string name = argv[++i];
+                if (name == "mesi")
+                    protocol = Protocol::MESI;
+                else if (name == "moesi")
+                    protocol = Protocol::MOESI;
+                else if (name == "mesif")
+                    protocol = Protocol::MESIF;
+                else if (name == "dragon")
+                    protocol = Protocol::Dragon;
+                else
+                {
+                    cerr << "Error: Unknown coherence protocol " << name << ".\n";
+                    return 1;
+                }
+            }
+            else
+            {
+                cerr << "Error: Missing argument for -p option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--sweep") == 0 || strcmp(argv[i], "-j") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                if (argv[i][1] == 'j')
+                    sweepThreads = atoi(argv[++i]);
+                else
+                    sweepSpec = argv[++i];
+            }
+            else
+            {
+                cerr << "Error: Missing argument for " << argv[i] << " option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            profileMaxE = 128;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                profileMaxE = atoi(argv[++i]);
+            }
+            if (profileMaxE < 1)
+            {
+                cerr << "Error: --profile needs a positive associativity.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--sample") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                sampleSpec = argv[++i];
+            }
+            else
+            {
+                cerr << "Error: Missing argument for --sample option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0)
+        {
+            if (i + 2 < argc)
+            {
+                checkpointFile = argv[++i];
+                checkpointPoint = argv[++i];
+            }
+            else
+            {
+                cerr << "Error: --checkpoint needs a file name and a cycle (or <n>a for accesses).\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--restore") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                restoreFile = argv[++i];
+            }
+            else
+            {
+                cerr << "Error: Missing argument for --restore option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--llc") == 0 || strcmp(argv[i], "--llc-latency") == 0 || strcmp(argv[i], "--llc-policy") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                cerr << "Error: Missing argument for " << argv[i] << " option.\n";
+                return 1;
+            }
+            if (strcmp(argv[i], "--llc") == 0)
+            {
+                llcSpec = argv[++i];
+            }
+            else if (strcmp(argv[i], "--llc-latency") == 0)
+            {
+                llcLatency = atoi(argv[++i]);
+            }
+            else
+            {
+                string policy = argv[++i];
+                if (policy == "inclusive")
+                    llcPolicy = LlcPolicy::Inclusive;
+                else if (policy == "non-inclusive")
+                    llcPolicy = LlcPolicy::NonInclusive;
+                else if (policy == "exclusive")
+                    llcPolicy = LlcPolicy::Exclusive;
+                else
+                {
+                    cerr << "Error: Unknown LLC policy " << policy << ".\n";
+                    return 1;
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--split") == 0)
+        {
+            splitOutstanding = 4;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                splitOutstanding = atoi(argv[++i]);
+                if (splitOutstanding < 1)
+                {
+                    cerr << "Error: --split needs at least one outstanding transaction.\n";
+                    return 1;
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--mshr") == 0)
+        {
+            if (i + 1 >= argc || (mshrCount = atoi(argv[++i])) < 1)
+            {
+                cerr << "Error: --mshr needs a positive number of MSHRs.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--events") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                eventsFile = argv[++i];
+            }
+            else
+            {
+                cerr << "Error: Missing argument for --events option.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--store-buffer") == 0)
+        {
+            if (i + 1 >= argc || (storeBufferDepth = atoi(argv[++i])) < 1)
+            {
+                cerr << "Error: --store-buffer needs a positive depth.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--prefetch") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                cerr << "Error: Missing argument for --prefetch option.\n";
+                return 1;
+            }
+            string spec = argv[++i];
+            string kind = spec.substr(0, spec.find(':'));
+            if (kind == "next")
+                prefetcher = PrefetchKind::NextLine;
+            else if (kind == "stride")
+                prefetcher = PrefetchKind::Stride;
+            else if (kind == "stream")
+                prefetcher = PrefetchKind::Stream;
+            else
+            {
+                cerr << "Error: Unknown prefetcher " << kind << ".\n";
+                return 1;
+            }
+            prefetchDegree = (prefetcher == PrefetchKind::Stream) ? 4 : 1;
+            if (kind.size() < spec.size() && (prefetchDegree = atoi(spec.c_str() + kind.size() + 1)) < 1)
+            {
+                cerr << "Error: --prefetch needs a positive degree.\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--event") == 0)
+        {
+            eventDriven = true;
+        }
+        else if (strcmp(argv[i], "--sharing") == 0)
+        {
+            sharingTop = 10;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                sharingTop = atoi(argv[++i]);
+                if (sharingTop < 1)
+                {
+                    cerr << "Error: --sharing needs a positive number of lines.\n";
+                    return 1;
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--classify") == 0)
+        {
+            classifyMisses = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                setHistogramFile = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "--timing") == 0)
+        {
+            printTiming = true;
+        }
+        else if (strcmp(argv[i], "--parallel") == 0)
+        {
+            parallelThreads = -1; // One per core
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                parallelThreads = atoi(argv[++i]);
+                if (parallelThreads < 1)
+                {
+                    cerr << "Error: --parallel needs a positive thread count.\n";
+                    return 1;
+                }
+            }
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            streamTraces = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                streamChunk = atoi(argv[++i]);
+            }
+        }
         else
         {
             cerr << "Error: Unknown option " << argv[i] << ".\n";
@@ -354,29 +1002,166 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if ((!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty()) && streamTraces)
+    {
+        cerr << "Error: --sweep, --profile and --sample need the traces in memory and cannot be combined with --stream.\n";
+        return 1;
+    }
+    if (parallelThreads != 0 && streamTraces)
+    {
+        cerr << "Error: --parallel needs the traces in memory and cannot be combined with --stream.\n";
+        return 1;
+    }
+    if (parallelThreads < 0)
+    {
+        parallelThreads = numCores;
+    }
+    if ((!checkpointFile.empty() || !restoreFile.empty()) && (!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty()))
+    {
+        cerr << "Error: --checkpoint and --restore cannot be combined with --sweep, --profile or --sample.\n";
+        return 1;
+    }
+    if (sharingTop > 0 && (!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty() || !checkpointFile.empty() || !restoreFile.empty()))
+    {
+        cerr << "Error: --sharing cannot be combined with --sweep, --profile, --sample, --checkpoint or --restore.\n";
+        return 1;
+    }
+    if (classifyMisses && (!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty() || !checkpointFile.empty() || !restoreFile.empty()))
+    {
+        cerr << "Error: --classify cannot be combined with --sweep, --profile, --sample, --checkpoint or --restore.\n";
+        return 1;
+    }
+    if (!eventsFile.empty() && (!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty()))
+    {
+        cerr << "Error: --events cannot be combined with --sweep, --profile or --sample.\n";
+        return 1;
+    }
+    if (printTiming && (!sweepSpec.empty() || profileMaxE > 0 || !sampleSpec.empty()))
+    {
+        cerr << "Error: --timing cannot be combined with --sweep, --profile or --sample.\n";
+        return 1;
+    }
+    long long checkpointAt = 0;
+    bool checkpointByAccesses = false;
+    if (!checkpointFile.empty())
+    {
+        char *end;
+        checkpointAt = strtoll(checkpointPoint.c_str(), &end, 10);
+        checkpointByAccesses = *end == 'a';
+        if (end == checkpointPoint.c_str() || checkpointAt < 0 || (*end && strcmp(end, "a") != 0))
+        {
+            cerr << "Error: Invalid checkpoint point " << checkpointPoint << " (a cycle, or <n>a for accesses).\n";
+            return 1;
+        }
+    }
+    int llcS = 0, llcE = 0, llcB = 0;
+    if (!llcSpec.empty())
+    {
+        char extra;
+        if (sscanf(llcSpec.c_str(), "%d:%d:%d%c", &llcS, &llcE, &llcB, &extra) != 3 || llcS < 0 || llcE < 1 ||
+            llcB < b || llcS + llcB > 32 || llcLatency < 0)
+        {
+            cerr << "Error: Invalid LLC " << llcSpec << " (s:E:b, with b at least the L1 block bits).\n";
+            return 1;
+        }
+        // An exclusive LLC line holds one L1 victim, so it cannot be larger
+        if (llcPolicy == LlcPolicy::Exclusive && llcB != b)
+        {
+            cerr << "Error: An exclusive LLC needs the L1 block size (b = " << b << ").\n";
+            return 1;
+        }
+        if (!sweepSpec.empty() || profileMaxE > 0)
+        {
+            cerr << "Error: --llc cannot be combined with --sweep or --profile.\n";
+            return 1;
+        }
+    }
+    SampleSpec sample;
+    if (!sampleSpec.empty() && !parseSampleSpec(sampleSpec, sample))
+    {
+        cerr << "Error: Invalid sample specification " << sampleSpec << " (interval[:window[:warmup]], interval >= window + warmup).\n";
+        return 1;
+    }
+
     // Load trace files
+    auto loadStart = chrono::steady_clock::now();
     if (!loadTraceFiles(tracePrefix))
     {
         cerr << "Error loading trace files. Exiting.\n";
         return 1;
     }
+    chrono::duration<double> loadTime = chrono::steady_clock::now() - loadStart;
 
-    // trace1 = {{'R', "0x0"}, {'W', "0x1000"}};
-    // trace2 = {{'R', "0x0"}};
-    // trace3 = {};
-    // trace4 = {};
-    // Initialize caches and MESI state vectors
-    for (int i = 0; i < 4; ++i)
+    if (profileMaxE > 0)
     {
-        caches[i].init();
-        mesiState[i].assign(1 << s, vector<MESIState>(E, MESIState::I));
+        if (outfilename.empty())
+        {
+            profileTraces(traces, s, b, profileMaxE, cout);
+            return 0;
+        }
+        ofstream profileFile(outfilename);
+        if (!profileFile.is_open())
+        {
+            cerr << "Error: Could not open output file " << outfilename << endl;
+            return 1;
+        }
+        profileTraces(traces, s, b, profileMaxE, profileFile);
+        return 0;
     }
 
-    // Initialize simulation counters
-    instructions.assign(4, 0);
-    clockCycles.assign(4, 0);
+    if (!sweepSpec.empty())
+    {
+        // Load once, simulate every configuration in parallel
+        vector<SweepPoint> points;
+        if (!parseSweepSpec(sweepSpec, SweepPoint{s, E, b}, points))
+        {
+            cerr << "Error: Invalid sweep specification.\n";
+            return 1;
+        }
+        SweepConfig config{replacementPolicy, eventDriven, protocol, splitOutstanding, mshrCount,
+                           prefetcher, prefetchDegree, storeBufferDepth};
+        return runSweep(points, traces, numCores, config, sweepThreads, outfilename) ? 0 : 1;
+    }
+
+    Simulator sim(s, b, E, numCores, replacementPolicy);
+    sim.protocol = protocol;
+    sim.eventDriven = eventDriven;
+    sim.splitOutstanding = splitOutstanding;
+    sim.mshrCount = mshrCount;
+    sim.prefetcher = prefetcher;
+    sim.prefetchDegree = prefetchDegree;
+    sim.storeBufferDepth = storeBufferDepth;
+    sim.sharingTop = sharingTop;
+    if (classifyMisses)
+    {
+        sim.enableClassify();
+    }
+    sim.parallelThreads = parallelThreads;
+    sim.traces = &traces;
+    sim.streams = streamTraces ? &traceStreams : nullptr;
+    if (!llcSpec.empty())
+    {
+        sim.enableLlc(llcS, llcE, llcB, llcLatency, llcPolicy);
+    }
+    sim.checkpointFile = checkpointFile;
+    sim.checkpointAt = checkpointAt;
+    sim.checkpointByAccesses = checkpointByAccesses;
+    if (!restoreFile.empty() && !sim.loadCheckpoint(restoreFile))
+    {
+        return 1;
+    }
+    EventLog eventLog;
+    if (!eventsFile.empty())
+    {
+        if (!eventLog.open(eventsFile, numCores, b))
+        {
+            return 1;
+        }
+        sim.events = &eventLog;
+    }
 
     // Set up output file if specified
+    auto simStart = chrono::steady_clock::now();
     ofstream outFile;
     if (!outfilename.empty())
     {
@@ -391,7 +1176,15 @@ int main(int argc, char *argv[])
         cout.rdbuf(outFile.rdbuf());
 
         // Run simulation
-        simulateMulticore();
+        if (!sampleSpec.empty())
+        {
+            runSampled(sim, sample, cout);
+        }
+        else
+        {
+            sim.simulate();
+            sim.printResults(cout);
+        }
 
         // Restore cout
         cout.rdbuf(coutBuffer);
@@ -400,18 +1193,52 @@ int main(int argc, char *argv[])
     else
     {
         // Run simulation with output to console
-        simulateMulticore();
+        if (!sampleSpec.empty())
+        {
+            runSampled(sim, sample, cout);
+        }
+        else
+        {
+            sim.simulate();
+            sim.printResults(cout);
+        }
     }
+    chrono::duration<double> simTime = chrono::steady_clock::now() - simStart;
 
-    // Clean up dynamically allocated memory for address strings
-    for (auto &p : trace1)
-        delete[] p.second;
-    for (auto &p : trace2)
-        delete[] p.second;
-    for (auto &p : trace3)
-        delete[] p.second;
-    for (auto &p : trace4)
-        delete[] p.second;
-
+    if (!sim.checkpointFile.empty())
+    {
+        cerr << "Error: Checkpoint " << sim.checkpointFile << " was not written.\n";
+        return 1;
+    }
+    if (sim.events && !eventLog.close())
+    {
+        cerr << "Error: Could not write event file " << eventsFile << ".\n";
+        return 1;
+    }
+    if (!setHistogramFile.empty() && !sim.writeSetHistogram(setHistogramFile))
+    {
+        return 1;
+    }
+    if (printTiming)
+    {
+        // On stderr, so the results stay comparable across runs
+        long long accesses = 0;
+        for (int i = 0; i < numCores; i++)
+        {
+            accesses += sim.instructions[i];
+        }
+        long long cycles = sim.globalCycle - 1;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cerr << fixed << setprecision(6);
+        cerr << "Trace Load Time (s): " << loadTime.count() << "\n";
+        cerr << "Simulation Time (s): " << simTime.count() << "\n";
+        cerr << "Accesses Simulated: " << accesses << "\n";
+        cerr << "Simulated Cycles: " << cycles << "\n";
+        cerr << setprecision(0);
+        cerr << "Accesses per Second: " << accesses / max(simTime.count(), 1e-9) << "\n";
+        cerr << "Cycles per Second: " << cycles / max(simTime.count(), 1e-9) << "\n";
+        cerr << "Peak RSS (KB): " << usage.ru_maxrss << "\n";
+    }
     return 0;
 }
\ No newline at end of file
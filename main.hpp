@@ -2,81 +2,279 @@
 #define MAIN_HPP
 
 #include <vector>
+#include <string>
 #include <utility>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include "cache.hpp"
+#include "bus.hpp"
+#include "coherence.hpp"
+#include "prefetch.hpp"
+#include "events.hpp"
+#include "sharing.hpp"
+#include "misses.hpp"
 
 // Bring in the standard namespace types you need.
 using namespace std;
-// External configuration parameters. These should be defined in main.cpp.
-extern int s; // Number of index bits: number of sets = 2^s
-extern int b; // Number of block offset bits: block size = 2^b bytes
-extern int E; // Associativity (number of lines per set)
-
-// External trace inputs for four cores.
-extern vector<pair<char, const char *>> trace1;
-extern vector<pair<char, const char *>> trace2;
-extern vector<pair<char, const char *>> trace3;
-extern vector<pair<char, const char *>> trace4;
-
-// Structure to hold a cache's per-core data.
-struct Cache
+
+// A single trace access, decoded once at load time.
+struct TraceAccess
+{
+    unsigned int address; // 32-bit byte address
+    bool write;           // true for W, false for R
+};
+
+const int MAX_CORES = 64; // Width of the sharer bitmask
+
+class TraceStream;
+class CoreWorkers;
+
+// One complete multicore simulation: configuration, caches, bus and
+// statistics. Simulations share nothing but the read-only traces, so several
+// can run side by side (see --sweep).
+struct Simulator
 {
-    int sets;      // Number of sets = 2^s
-    int blockSize; // Block size = 2^b bytes
-    bool stall;
-    vector<vector<unsigned int>> tags; // Tag storage [set][line]
-    vector<vector<bool>> valid;        // Valid bits [set][line]
-    vector<vector<int>> lru;           // LRU ordering [set] holds line indices
-    vector<vector<bool>> dirty;        // Dirty bits [set][line]
-
-    // Initialize the cache based on the global parameters s, b, and E.
-    void init()
+    // Configuration parameters
+    int s; // Number of index bits: number of sets = 2^s
+    int b; // Number of block offset bits: block size = 2^b bytes
+    int E; // Associativity (number of lines per set)
+    int numCores;
+    ReplPolicy replacementPolicy;
+    Protocol protocol;
+    bool eventDriven; // Skip cycles in which every core waits on the bus
+    int parallelThreads; // Run hit streaks on this many threads (0 = off)
+    int mshrCount; // Non-blocking caches: outstanding misses per core (0 = blocking)
+    PrefetchKind prefetcher;
+    int prefetchDegree; // Blocks a prefetcher runs ahead
+    int storeBufferDepth; // Stores each core may have buffered (0 = no store buffer)
+    EventLog *events;     // Event recorder (--events), null when off
+    int sharingTop;       // False-sharing analysis: lines to list (0 = off)
+    bool classifyMisses;  // Miss classification and per-set histograms (--classify)
+
+    // Optional shared last-level cache between the bus and memory (--llc).
+    // Its lines are either valid (E) or invalid (I); dirty marks a block
+    // newer than memory. Without it every fill and writeback takes 100 cycles.
+    bool llcEnabled;
+    int llcS, llcE, llcB;
+    int llcLatency; // Bus cycles for an LLC hit or a writeback into the LLC
+    LlcPolicy llcPolicy;
+    Cache llc;
+
+    // Checkpoint that simulate() writes at the first step boundary where
+    // globalCycle (or, with checkpointByAccesses, the accesses retired by all
+    // cores together) reaches checkpointAt; cleared once written
+    string checkpointFile;
+    long long checkpointAt;
+    bool checkpointByAccesses;
+
+    // Trace inputs, one per core: in memory, or streamed when streams is set
+    const vector<vector<TraceAccess>> *traces;
+    vector<unique_ptr<TraceStream>> *streams;
+
+    // Caches and bus
+    vector<Cache> caches;
+    RingBuffer<BusReq> busQueue;      // At most one waiting request per core
+    RingBuffer<BusData> busDataQueue;
+    unordered_map<unsigned int, SharerEntry> sharerDirectory;
+    vector<int> corePendingOperation; // -1 indicates no pending operation
+    vector<bool> waitingForBus;       // Core has a request queued for the bus
+    bool bus_busy;
+    int splitOutstanding; // Split-transaction bus: transfers in flight at once (0 = atomic bus)
+    int cycle;  // Bus cycles simulated so far
+    int cycle2; // Calls to run()
+
+    // Simulation progress
+    vector<size_t> tracePos;
+    vector<bool> coreActive;
+    int globalCycle;
+    int maxtime;
+
+    // Statistics
+    vector<int> instructions;
+    vector<int> clockCycles;
+    vector<int> num_reads;
+    vector<int> num_writes;
+    vector<int> cache_misses;
+    vector<int> cache_evictions;
+    vector<int> writebacks;
+    vector<int> bus_invalidations;
+    vector<int> bus_updates; // Dragon word updates broadcast
+    vector<long long> data_traffic_bytes;
+    vector<int> idle_cycles;
+    int total_bus_transactions;
+    long long total_bus_traffic_bytes;
+    long long busQueueDepthSum; // Sum over cycles of queued requests
+    long long busWaitCycles;    // Cycles granted requests spent queued
+    long long busGrants;
+    int busMaxWait;
+    long long busBusyCycles;    // Cycles with a transfer on the bus
+    long long busConflicts;     // Request-cycles held back by a transfer of the same block
+    vector<long long> llcHits;
+    vector<long long> llcMisses;
+    vector<long long> llcBackInvalidations; // L1 lines dropped to keep the LLC inclusive
+    vector<long long> memoryTrafficBytes;   // Memory reads and writes a core caused
+    long long memoryWritebacks;
+    vector<long long> mshrAllocations; // Misses that took an MSHR
+    vector<long long> mshrMerges;      // Misses merged into an MSHR of the same block
+    vector<long long> mshrFullCycles;  // Cycles a miss waited for a free MSHR
+    vector<long long> mshrOccupancy;   // Sum over cycles of the MSHRs in use
+    vector<int> mshrPeak;
+    vector<PrefetchTrainer> prefetchTrainers;
+    vector<vector<PrefetchPending>> prefetchPending; // Per core, oldest first
+    vector<long long> prefetchIssued;
+    vector<long long> prefetchUseful;      // Used after they arrived
+    vector<long long> prefetchLate;        // Demand access waited for them
+    vector<long long> prefetchUseless;     // Evicted or invalidated unused
+    vector<long long> prefetchInvalidated; // Of those, invalidated by another core
+    vector<long long> prefetchTrafficBytes;
+    vector<vector<int>> storeBuffers; // Per core, oldest store first
+    vector<bool> storeInFlight;       // The oldest store waits for its bus transfer
+    vector<long long> storesBuffered;
+    vector<long long> storeForwards;   // Reads served from the store buffer
+    vector<long long> storeFullCycles; // Cycles a write waited for room
+    vector<long long> storeOccupancy;  // Sum over cycles of the buffered stores
+    vector<int> storePeak;
+    vector<unordered_map<unsigned int, SharingTouch>> sharingTouches; // Per core, by block
+    unordered_map<unsigned int, SharingBlock> sharingBlocks;
+    vector<MissClassifier> missClassifiers;
+
+    // Parallel kernel scratch: running cores, their hit streaks and the way
+    // each hit of a core's streak found
+    vector<int> hitCores;
+    vector<int> hitStreaks;
+    vector<vector<int>> hitWays;
+
+    Simulator(int s, int b, int E, int numCores, ReplPolicy replacementPolicy);
+
+    // Runs the traces to completion (main.cpp)
+    void simulate();
+    bool step(CoreWorkers *workers);
+    void printResults(ostream &out);
+    const TraceAccess *traceAt(int core, size_t pos);
+    // Bulk accounting for cycles in which the bus only counts down: what
+    // run() and bus() would have counted one cycle at a time
+    void skipCycles(int span);
+
+    // Parallel kernel (parallel.cpp): simulates the cycles up to the next
+    // coherence event at once, returns how many (0 if the next one has one)
+    int hitWindow(CoreWorkers &workers);
+
+    // Runs a single memory operation (read/write) for a given core (cache.cpp)
+    void run(const TraceAccess &entry, int core);
+    int handle_read_miss(int core, int index, int tag, bool &iswriteback);
+    // Handles a write miss for a given core, index, and tag
+    int handle_write_miss(int core, int index, int tag, bool &iswriteback);
+    // Number of upcoming accesses (at most limit) that hit without needing
+    // the bus, never counting the last access of the trace; and running the
+    // first count of them
+    int hitStreak(int core, int limit);
+    void applyHits(int core, int count);
+
+    // Non-blocking caches (mshr.cpp): a miss that takes (true) or merges into
+    // an MSHR instead of stalling the core, the fill that frees it, and the
+    // per-cycle occupancy accounting
+    bool mshrMiss(int core, int addr, bool write);
+    void mshrRetire(int core, int addr);
+    void mshrTick(int cycles);
+
+    // Prefetchers (prefetch.cpp): training on a demand miss or the first use
+    // of a prefetched block, queueing prefetches, a demand access waiting for
+    // a late one, and the fate of the prefetched lines
+    void prefetchTrain(int core, int addr, bool miss);
+    void prefetchIssue(int core, unsigned int block);
+    bool prefetchWait(int core, int addr);
+    void prefetchUsed(int core, int addr, CacheLine &line);
+    void prefetchFilled(int core, int addr, CacheLine &line);
+    void prefetchLost(int core, CacheLine &line, bool invalidated);
+
+    // Store buffers (storebuffer.cpp): a write that is buffered (true) or can
+    // go to the cache at once, a read that the buffer serves or holds back,
+    // draining the oldest store and its completion, and the kernels' check
+    // that no buffer can drain before the next bus event
+    bool storeWrite(int core, int addr);
+    bool storeLoad(int core, int addr, bool cached);
+    void storeDrain(int core);
+    void storeRetire(int core);
+    void storeTick(int cycles);
+    bool storesQuiet();
+
+    // False-sharing analysis (sharing.cpp): the offsets of a retired access,
+    // a granted request's ownership change and coherence cost, a copy lost to
+    // another core's write, and the report
+    void sharingAccess(int core, const TraceAccess &entry);
+    void sharingGrant(int core, int addr, BusReqType type, bool prefetch, int cycles);
+    void sharingInvalidate(int core, unsigned int block);
+    void printSharing(ostream &out);
+
+    // Miss classification (misses.cpp): setting it up, a retired access for
+    // the shadow cache, a granted miss, a copy lost to another core's write,
+    // and the per-set histogram as CSV
+    void enableClassify();
+    void classifyAccess(int core, const TraceAccess &entry);
+    void classifyIssue(int core, int addr);
+    void classifyMiss(int core, int addr, bool prefetch);
+    void classifyInvalidate(int core, unsigned int block);
+    bool writeSetHistogram(const string &filename);
+
+    // Complete simulator state to and from a binary file (checkpoint.cpp).
+    // Restoring needs a Simulator built with the same configuration and traces.
+    bool saveCheckpoint(const string &filename);
+    bool loadCheckpoint(const string &filename);
+
+    // Sampling support (sample.cpp): functional warming of one access, and
+    // clearing the bus when a detailed window ends
+    void warmAccess(int core, const TraceAccess &entry);
+    int warmFill(int core, int index, int tag);
+    void dropBusState();
+
+    // Shared LLC (llc.cpp). Each returns the bus cycles of the transfer: an
+    // L1 fill, a writeback of a dirty L1 block that the L1 evicts or (keep)
+    // still holds, and the silent eviction of a clean block.
+    void enableLlc(int llcS, int llcE, int llcB, int latency, LlcPolicy policy);
+    int fetchStalls(int core, int addr);
+    int writebackStalls(int core, int addr, bool keep);
+    void cleanEviction(int core, int addr);
+    int llcFind(unsigned int addr);
+    void llcAllocate(int core, unsigned int addr, bool dirty);
+    void backInvalidate(int core, unsigned int addr);
+
+    // Coherence protocol (coherence.cpp): the three bus transactions as seen
+    // by the snooping caches, and the protocol's choice of line states
+    void busRead(int core, int addr, int index, int tag);
+    void busReadExclusive(int core, int addr, int index, int tag);
+    void busUpgrade(int core, int addr, int index, int tag);
+    MESIState readSnoopState(MESIState state, bool &writeback);
+    MESIState readFillState(bool shared);
+    MESIState writeFillState(bool shared);
+
+    // One bus cycle (bus.cpp), and queueing a request for it
+    void bus();
+    void busRequest(const BusReq &req);
+    // Event-driven kernel support: how many upcoming cycles the bus will spend
+    // only counting down the current transfer (if any), and accounting for
+    // them in bulk.
+    int busQuietCycles();
+    void busSkip(int cycles);
+    void completeTransfer(const BusData &busData);
+    bool blockInFlight(int addr);
+
+    // Sharer directory maintenance (bus.cpp)
+    unsigned int blockAddress(int index, int tag); // Block number of a cached line
+    void dirAdd(unsigned int block, int core, bool owner);
+    void dirRemove(unsigned int block, int core);
+    void dirClearOwner(unsigned int block);
+    unsigned long long dirSharers(unsigned int block);
+    int findLine(int core, int index, int tag);
+
+    // Event recording (--events); costs one test when no log is attached
+    void logEvent(EventType type, int core, int addr, int a, int b, int arg)
     {
-        sets = 1 << s;      // Number of sets = 2^s
-        blockSize = 1 << b; // Block size = 2^b bytes
-
-        // Resize and initialize cache data structures.
-        tags.assign(sets, vector<unsigned int>(E, 0));
-        valid.assign(sets, vector<bool>(E, false));
-        dirty.assign(sets, vector<bool>(E, false));
-
-        // Initialize the LRU ordering: for each set, create an ordering of block indices 0 to E-1.
-        lru.clear();
-        lru.resize(sets);
-        for (int i = 0; i < sets; i++)
+        if (events)
         {
-            lru[i].clear();
-            for (int j = 0; j < E; j++)
-            {
-                lru[i].push_back(j);
-            }
+            events->record(type, globalCycle, core, (unsigned int)addr, a, b, arg);
         }
     }
 };
 
-extern Cache caches[4];
-
-enum class MESIState
-{
-    M,
-    E,
-    S,
-    I
-};
-extern vector<vector<MESIState>> mesiState[4];
-
-extern vector<int> instructions;
-extern vector<int> clockCycles;
-
-extern vector<int> num_reads;
-extern vector<int> num_writes;
-extern vector<int> cache_misses;
-extern vector<int> cache_evictions;
-extern vector<int> writebacks;
-extern vector<int> bus_invalidations;
-extern vector<long long> data_traffic_bytes;
-extern vector<int> idle_cycles;
-extern int total_bus_transactions;
-extern long long total_bus_traffic_bytes;
-
-extern vector<bool> coreActive;
-#endif // MAIN_HPP
\ No newline at end of file
+#endif // MAIN_HPP
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cctype>
+#include "main.hpp"
+#include "misses.hpp"
+
+using namespace std;
+
+const char *missClassName(MissClass c)
+{
+    switch (c)
+    {
+    case MissClass::Compulsory:
+        return "Compulsory";
+    case MissClass::Capacity:
+        return "Capacity";
+    case MissClass::Conflict:
+        return "Conflict";
+    default:
+        return "Coherence";
+    }
+}
+
+void ShadowCache::init(size_t lines)
+{
+    capacity = lines;
+    order.clear();
+    where.clear();
+}
+
+void ShadowCache::access(unsigned int block)
+{
+    auto it = where.find(block);
+    if (it != where.end())
+    {
+        order.splice(order.begin(), order, it->second);
+        return;
+    }
+    if (order.size() == capacity)
+    {
+        where.erase(order.back());
+        order.pop_back();
+    }
+    order.push_front(block);
+    where[block] = order.begin();
+}
+
+void Simulator::enableClassify()
+{
+    classifyMisses = true;
+    missClassifiers.assign(numCores, MissClassifier());
+    for (MissClassifier &c : missClassifiers)
+    {
+        c.shadow.init((size_t)E << s);
+        for (long long &count : c.counts)
+        {
+            count = 0;
+        }
+        c.setMisses.assign((size_t)MISS_CLASSES << s, 0);
+        c.setEvictions.assign((size_t)1 << s, 0);
+    }
+}
+
+// A retired access; runs on the core's own thread under --parallel
+void Simulator::classifyAccess(int core, const TraceAccess &entry)
+{
+    missClassifiers[core].shadow.access(entry.address >> b);
+}
+
+// Class of a miss of the block, as long as the shadow cache has not seen the
+// access that missed
+static MissClass missClassOf(const MissClassifier &c, unsigned int block)
+{
+    if (c.invalidated.count(block))
+        return MissClass::Coherence;
+    if (!c.touched.count(block))
+        return MissClass::Compulsory;
+    return c.shadow.contains(block) ? MissClass::Conflict : MissClass::Capacity;
+}
+
+// A demand miss about to request its block. With --mshr or --store-buffer
+// the core runs on, and the shadow cache sees later accesses, before the
+// request is granted, so the miss is classed now.
+void Simulator::classifyIssue(int core, int addr)
+{
+    MissClassifier &c = missClassifiers[core];
+    unsigned int block = (unsigned int)addr >> b;
+    c.issued[block] = missClassOf(c, block);
+}
+
+// A granted BusRd or BusRdX, counted as a miss unless it is a prefetch. An
+// upgrade that lost its copy while it waited has no class yet and gets one
+// here.
+void Simulator::classifyMiss(int core, int addr, bool prefetch)
+{
+    MissClassifier &c = missClassifiers[core];
+    unsigned int block = (unsigned int)addr >> b;
+    MissClass kind;
+    auto it = c.issued.find(block);
+    if (it != c.issued.end())
+    {
+        kind = it->second;
+        c.issued.erase(it);
+    }
+    else
+    {
+        kind = missClassOf(c, block);
+    }
+    c.invalidated.erase(block);
+    c.touched.insert(block);
+    if (prefetch)
+    {
+        return;
+    }
+    int index = (addr >> b) & ((1 << s) - 1);
+    c.counts[(int)kind]++;
+    c.setMisses[(size_t)index * MISS_CLASSES + (int)kind]++;
+}
+
+// Another core's BusRdX or BusUpgr invalidated a core's copy
+void Simulator::classifyInvalidate(int core, unsigned int block)
+{
+    missClassifiers[core].invalidated.insert(block);
+}
+
+// Per-set misses by class and evictions of every core, as CSV for heatmaps
+bool Simulator::writeSetHistogram(const string &filename)
+{
+    ofstream out(filename);
+    if (!out.is_open())
+    {
+        cerr << "Error: Could not open output file " << filename << endl;
+        return false;
+    }
+    out << "core,set";
+    for (int k = 0; k < MISS_CLASSES; k++)
+    {
+        string name = missClassName((MissClass)k);
+        name[0] = (char)tolower(name[0]);
+        out << "," << name;
+    }
+    out << ",misses,evictions\n";
+    for (int i = 0; i < numCores; i++)
+    {
+        const MissClassifier &c = missClassifiers[i];
+        for (int set = 0; set < (1 << s); set++)
+        {
+            long long misses = 0;
+            out << i << "," << set;
+            for (int k = 0; k < MISS_CLASSES; k++)
+            {
+                long long n = c.setMisses[(size_t)set * MISS_CLASSES + k];
+                misses += n;
+                out << "," << n;
+            }
+            out << "," << misses << "," << c.setEvictions[set] << "\n";
+        }
+    }
+    out.close();
+    if (!out)
+    {
+        cerr << "Error: Could not write " << filename << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef MISSES_HPP
+#define MISSES_HPP
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+// Miss classification (--classify). Every demand miss of a core is:
+//   coherence   its copy of the block was invalidated by another core's write
+//   compulsory  the core never had the block before
+//   conflict    a fully associative LRU cache of the same size would still
+//               hold it, so only the set mapping lost it
+//   capacity    otherwise: even full associativity would have lost it
+enum class MissClass
+{
+    Compulsory,
+    Capacity,
+    Conflict,
+    Coherence
+};
+
+const int MISS_CLASSES = 4;
+
+const char *missClassName(MissClass c);
+
+// Fully associative LRU cache of block numbers with the capacity of a core's
+// cache, fed with that core's accesses in the order its cache sees them: as
+// they retire, except that buffered stores come when they drain
+class ShadowCache
+{
+public:
+    void init(size_t lines);
+    bool contains(unsigned int block) const { return where.count(block) != 0; }
+    void access(unsigned int block);
+
+private:
+    size_t capacity = 0;
+    list<unsigned int> order; // Most recently used first
+    unordered_map<unsigned int, list<unsigned int>::iterator> where;
+};
+
+// Classification state and per-set histogram of one core
+struct MissClassifier
+{
+    ShadowCache shadow;
+    unordered_set<unsigned int> touched;     // Blocks the core has fetched
+    unordered_set<unsigned int> invalidated; // Blocks other cores' writes took away
+    unordered_map<unsigned int, MissClass> issued; // Misses waiting for the bus, classed when detected
+    long long counts[MISS_CLASSES];
+    vector<long long> setMisses;             // [set * MISS_CLASSES + class]
+    vector<long long> setEvictions;
+};
+
+#endif // MISSES_HPP
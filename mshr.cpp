@@ -0,0 +1,74 @@
+#include <algorithm>
+#include "main.hpp"
+
+using namespace std;
+
+// A read or write miss of a non-blocking cache. A miss to a block that is
+// already being fetched merges into its MSHR, except a write to a block that
+// comes in for reading: that write waits for the fill and then upgrades. A
+// miss to another block takes a free MSHR and queues its bus request; with
+// all MSHRs busy the core stalls and retries next cycle.
+bool Simulator::mshrMiss(int core, int addr, bool write)
+{
+    Cache &cache = caches[core];
+    unsigned int block = (unsigned int)addr >> b;
+    for (const Mshr &reg : cache.mshrs)
+    {
+        if (reg.block != block)
+        {
+            continue;
+        }
+        if (write && !reg.write)
+        {
+            cache.stall = true;
+            clockCycles[core]++;
+            idle_cycles[core]++;
+            return false;
+        }
+        mshrMerges[core]++;
+        return false;
+    }
+
+    if ((int)cache.mshrs.size() == mshrCount)
+    {
+        cache.stall = true;
+        clockCycles[core]++;
+        idle_cycles[core]++;
+        mshrFullCycles[core]++;
+        return false;
+    }
+    cache.mshrs.push_back(Mshr{block, write});
+    mshrAllocations[core]++;
+    mshrPeak[core] = max(mshrPeak[core], (int)cache.mshrs.size());
+    if (classifyMisses)
+    {
+        classifyIssue(core, addr);
+    }
+    BusReq req{core, addr, write ? BusReqType::BusRdX : BusReqType::BusRd, cycle};
+    req.mshr = true;
+    busRequest(req);
+    return true;
+}
+
+// The fill of a block has arrived: free its MSHR
+void Simulator::mshrRetire(int core, int addr)
+{
+    vector<Mshr> &mshrs = caches[core].mshrs;
+    unsigned int block = (unsigned int)addr >> b;
+    for (size_t k = 0; k < mshrs.size(); k++)
+    {
+        if (mshrs[k].block == block)
+        {
+            mshrs.erase(mshrs.begin() + k);
+            return;
+        }
+    }
+}
+
+void Simulator::mshrTick(int cycles)
+{
+    for (int i = 0; i < numCores; i++)
+    {
+        mshrOccupancy[i] += (long long)caches[i].mshrs.size() * cycles;
+    }
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include "main.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+CoreWorkers::CoreWorkers(int threads)
+    : task(nullptr), count(0), running(0), generation(0), stop(false)
+{
+    for (int id = 1; id < threads; id++)
+    {
+        workers.emplace_back(&CoreWorkers::loop, this, id);
+    }
+}
+
+CoreWorkers::~CoreWorkers()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void CoreWorkers::runShare(int id)
+{
+    for (int k = id; k < count; k += size())
+    {
+        (*task)(k);
+    }
+}
+
+void CoreWorkers::loop(int id)
+{
+    unsigned long long seen = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&]
+                      { return stop || generation != seen; });
+            if (stop)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        runShare(id);
+        {
+            lock_guard<mutex> guard(lock);
+            if (--running == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+}
+
+void CoreWorkers::forEach(int count, const function<void(int)> &task)
+{
+    if (workers.empty() || count <= 1)
+    {
+        for (int k = 0; k < count; k++)
+        {
+            task(k);
+        }
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        this->task = &task;
+        this->count = count;
+        running = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    runShare(0);
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [&]
+                  { return running == 0; });
+}
+
+// Windows shorter than this are run on the simulation thread: waking the
+// workers costs more than the hits themselves.
+const int HIT_WINDOW_SERIAL = 256;
+// Longest window, so that one long streak does not hold back the others
+const int HIT_WINDOW_MAX = 1 << 16;
+
+// Between two coherence events every running core only hits in its own
+// cache, which touches nothing another core can see. A window is the number
+// of cycles until the first event: the end of the current bus countdown, or
+// the first access of any running core that misses, needs a BusUpgr or is
+// the last of its trace. The hits of the window are found and then applied
+// one core per thread; the blocked cores and the bus are advanced in bulk
+// exactly as the event-driven kernel does. Returns the number of cycles
+// simulated, 0 when the next cycle must go through the serial kernel.
+int Simulator::hitWindow(CoreWorkers &workers)
+{
+    int span;
+    if (!bus_busy && busQueue.empty() && busDataQueue.empty())
+    {
+        span = HIT_WINDOW_MAX; // Nothing on the bus until some core misses
+    }
+    else
+    {
+        span = min(busQuietCycles(), HIT_WINDOW_MAX);
+    }
+    if (span == 0 || !storesQuiet())
+    {
+        return 0;
+    }
+
+    hitCores.clear();
+    for (int i = 0; i < numCores; i++)
+    {
+        if (!coreActive[i] || (caches[i].stall && (corePendingOperation[i] != -1 || waitingForBus[i])))
+        {
+            continue;
+        }
+        // A running core's writes would go through a non-empty store buffer
+        if (caches[i].stall || corePendingOperation[i] != -1 || waitingForBus[i] || !storeBuffers[i].empty())
+        {
+            return 0;
+        }
+        hitCores.push_back(i);
+    }
+    if (hitCores.empty() && !bus_busy)
+    {
+        return 0;
+    }
+
+    // Probe a short window here first; only a window that is certain to be
+    // long is handed to the workers.
+    int limit = span;
+    for (int core : hitCores)
+    {
+        span = min(span, hitStreak(core, min(span, HIT_WINDOW_SERIAL)));
+    }
+    if (span == 0)
+    {
+        return 0;
+    }
+    if (span == HIT_WINDOW_SERIAL && limit > HIT_WINDOW_SERIAL && hitCores.size() > 1)
+    {
+        hitStreaks.assign(hitCores.size(), 0);
+        workers.forEach(hitCores.size(), [&](int k)
+                        { hitStreaks[k] = hitStreak(hitCores[k], limit); });
+        span = *min_element(hitStreaks.begin(), hitStreaks.end());
+        workers.forEach(hitCores.size(), [&](int k)
+                        { applyHits(hitCores[k], span); });
+    }
+    else
+    {
+        if (span == HIT_WINDOW_SERIAL && limit > HIT_WINDOW_SERIAL)
+        {
+            span = hitStreak(hitCores[0], limit);
+        }
+        for (int core : hitCores)
+        {
+            applyHits(core, span);
+        }
+    }
+
+    skipCycles(span);
+    return span;
+}
@@ -0,0 +1,38 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+// A fixed set of threads for the parallel kernel (--parallel). forEach()
+// spreads task(0) .. task(count - 1) over the threads (the caller's thread
+// included) and returns once all of them are done, so every call is a barrier.
+class CoreWorkers
+{
+public:
+    explicit CoreWorkers(int threads);
+    ~CoreWorkers();
+    int size() const { return (int)workers.size() + 1; }
+    void forEach(int count, const function<void(int)> &task);
+
+private:
+    void loop(int id);
+    void runShare(int id);
+
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    const function<void(int)> *task;
+    int count;
+    int running;                  // Workers still busy with the current task
+    unsigned long long generation; // Bumped for every forEach()
+    bool stop;
+};
+
+#endif // PARALLEL_HPP
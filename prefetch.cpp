@@ -0,0 +1,215 @@
+#include "main.hpp"
+#include "prefetch.hpp"
+
+using namespace std;
+
+const char *prefetchKindName(PrefetchKind kind)
+{
+    switch (kind)
+    {
+    case PrefetchKind::NextLine:
+        return "Next-Line";
+    case PrefetchKind::Stride:
+        return "Stride";
+    case PrefetchKind::Stream:
+        return "Stream";
+    default:
+        return "None";
+    }
+}
+
+// Queues a prefetch of a block unless the core holds it, already fetches it
+// or has no room left for another prefetch
+void Simulator::prefetchIssue(int core, unsigned int block)
+{
+    vector<PrefetchPending> &pending = prefetchPending[core];
+    if ((int)pending.size() == PREFETCH_QUEUE)
+    {
+        return;
+    }
+    int addr = (int)(block << b);
+    block = (unsigned int)addr >> b;
+    int index = (addr >> b) & ((1 << s) - 1);
+    int tag = addr >> (s + b);
+    if (findLine(core, index, tag) != -1)
+    {
+        return;
+    }
+    for (const PrefetchPending &p : pending)
+    {
+        if (p.block == block)
+            return;
+    }
+    for (const Mshr &reg : caches[core].mshrs)
+    {
+        if (reg.block == block)
+            return;
+    }
+    for (int store : storeBuffers[core])
+    {
+        if ((unsigned int)store >> b == block)
+            return;
+    }
+    pending.push_back(PrefetchPending{block, false});
+    prefetchIssued[core]++;
+    BusReq req{core, addr, BusReqType::BusRd, cycle};
+    req.mshr = true;
+    req.prefetch = true;
+    busRequest(req);
+}
+
+// A demand access to a block whose prefetch has not arrived yet waits for it
+// (the prefetch is late) rather than fetching the block a second time
+bool Simulator::prefetchWait(int core, int addr)
+{
+    unsigned int block = (unsigned int)addr >> b;
+    for (PrefetchPending &p : prefetchPending[core])
+    {
+        if (p.block == block)
+        {
+            p.late = true;
+            caches[core].stall = true;
+            clockCycles[core]++;
+            idle_cycles[core]++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Feeds a demand miss (miss) or the first use of a prefetched block to the
+// core's prefetcher, which queues the blocks it predicts
+void Simulator::prefetchTrain(int core, int addr, bool miss)
+{
+    PrefetchTrainer &t = prefetchTrainers[core];
+    unsigned int block = (unsigned int)addr >> b;
+    t.triggers++;
+    switch (prefetcher)
+    {
+    case PrefetchKind::NextLine:
+        for (int k = 1; k <= prefetchDegree; k++)
+        {
+            prefetchIssue(core, block + k);
+        }
+        break;
+    case PrefetchKind::Stride:
+    {
+        int delta = (int)(block - t.lastBlock);
+        if (delta != 0 && delta == t.delta)
+        {
+            t.confidence++;
+        }
+        else
+        {
+            t.delta = delta;
+            t.confidence = 0;
+        }
+        t.lastBlock = block;
+        if (t.confidence > 0)
+        {
+            for (int k = 1; k <= prefetchDegree; k++)
+            {
+                prefetchIssue(core, block + k * delta);
+            }
+        }
+        break;
+    }
+    case PrefetchKind::Stream:
+    {
+        unsigned int lastMiss = t.lastMiss;
+        if (miss)
+        {
+            t.lastMiss = block;
+        }
+        // A use within prefetchDegree blocks behind a stream's head keeps
+        // that stream prefetchDegree blocks ahead of it
+        PrefetchStream *stream = nullptr;
+        for (PrefetchStream &st : t.streams)
+        {
+            int ahead = (int)(st.next - block) * st.dir;
+            if (st.valid && ahead >= 0 && ahead <= prefetchDegree)
+            {
+                stream = &st;
+                break;
+            }
+        }
+        // Otherwise two misses to neighbouring blocks start a stream in
+        // place of the least recently used one
+        if (!stream)
+        {
+            int dir = (block == lastMiss + 1) ? 1 : (block == lastMiss - 1) ? -1 : 0;
+            if (!miss || dir == 0)
+            {
+                break;
+            }
+            stream = &t.streams[0];
+            for (PrefetchStream &st : t.streams)
+            {
+                if (!st.valid || (stream->valid && st.lastUse < stream->lastUse))
+                {
+                    stream = &st;
+                }
+            }
+            *stream = PrefetchStream{true, dir, block, 0};
+        }
+        stream->lastUse = t.triggers;
+        if (stream->next == block)
+        {
+            stream->next += stream->dir;
+        }
+        while ((int)(stream->next - block) * stream->dir <= prefetchDegree)
+        {
+            prefetchIssue(core, stream->next);
+            stream->next += stream->dir;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// First demand access to a prefetched block
+void Simulator::prefetchUsed(int core, int addr, CacheLine &line)
+{
+    line.prefetched = false;
+    prefetchUseful[core]++;
+    prefetchTrain(core, addr, false);
+}
+
+// A prefetch fill has arrived; a demand access already waiting for it makes
+// it late, and that access uses the block right away
+void Simulator::prefetchFilled(int core, int addr, CacheLine &line)
+{
+    vector<PrefetchPending> &pending = prefetchPending[core];
+    unsigned int block = (unsigned int)addr >> b;
+    for (size_t k = 0; k < pending.size(); k++)
+    {
+        if (pending[k].block == block)
+        {
+            line.prefetched = !pending[k].late;
+            if (pending[k].late)
+            {
+                prefetchLate[core]++;
+            }
+            pending.erase(pending.begin() + k);
+            return;
+        }
+    }
+}
+
+// A line leaves the cache, evicted or invalidated by another core's write;
+// if it was prefetched and never used the prefetch was useless
+void Simulator::prefetchLost(int core, CacheLine &line, bool invalidated)
+{
+    if (!line.prefetched)
+    {
+        return;
+    }
+    line.prefetched = false;
+    prefetchUseless[core]++;
+    if (invalidated)
+    {
+        prefetchInvalidated[core]++;
+    }
+}
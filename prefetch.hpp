@@ -0,0 +1,52 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+// Hardware prefetchers selectable with --prefetch. Each core's prefetcher
+// watches that core's demand misses (and first uses of prefetched blocks) and
+// queues BusRd fills that the bus grants only when no demand request waits:
+//   next    the next n blocks after the trigger
+//   stride  n blocks ahead along a delta seen twice in a row (no PCs in the
+//           traces, so one delta per core)
+//   stream  up to STREAM_BUFFERS sequential streams, each confirmed by two
+//           misses to neighbouring blocks and kept n blocks ahead
+enum class PrefetchKind
+{
+    None,
+    NextLine,
+    Stride,
+    Stream
+};
+
+const int PREFETCH_QUEUE = 16; // Prefetches a core may have queued or in flight
+const int STREAM_BUFFERS = 4;
+
+// Name of a prefetcher as printed in the results
+const char *prefetchKindName(PrefetchKind kind);
+
+// A prefetch not yet filled; late once a demand access waits for it
+struct PrefetchPending
+{
+    unsigned int block;
+    bool late;
+};
+
+struct PrefetchStream
+{
+    bool valid;
+    int dir;              // +1 or -1 blocks
+    unsigned int next;    // Next block to prefetch
+    unsigned int lastUse; // Trigger count at its last use, for replacement
+};
+
+// Training state of one core's prefetcher
+struct PrefetchTrainer
+{
+    unsigned int lastBlock; // Stride: previous trigger block
+    int delta;              // Stride: last delta seen
+    int confidence;         // Stride: times in a row it repeated
+    unsigned int lastMiss;  // Stream: previous demand miss block
+    unsigned int triggers;
+    PrefetchStream streams[STREAM_BUFFERS];
+};
+
+#endif // PREFETCH_HPP
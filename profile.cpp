@@ -0,0 +1,167 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "profile.hpp"
+
+using namespace std;
+
+// Stack distance histograms of one core
+struct StackProfile
+{
+    long long accesses = 0;
+    vector<long long> setHist; // [d] = accesses at per-set stack distance d < maxE
+    vector<long long> fullHist; // [0] = reuses at fully associative distance 0, [k] = distance in [2^(k-1), 2^k)
+};
+
+// Fenwick tree over access times, holding a 1 at the latest access of every block
+class DistinctCounter
+{
+public:
+    explicit DistinctCounter(size_t n) : tree(n + 1, 0) {}
+    void add(size_t i, int v)
+    {
+        for (i++; i < tree.size(); i += i & (0 - i))
+            tree[i] += v;
+    }
+    long long prefix(size_t i) // Sum of [0, i)
+    {
+        long long sum = 0;
+        for (; i > 0; i -= i & (0 - i))
+            sum += tree[i];
+        return sum;
+    }
+
+private:
+    vector<int> tree;
+};
+
+static StackProfile profileCore(const vector<TraceAccess> &trace, int s, int b, int maxE)
+{
+    StackProfile p;
+    p.setHist.assign(maxE, 0);
+    p.fullHist.assign(33, 0);
+
+    // Per-set LRU stacks (most recent first), cut at maxE since deeper
+    // references miss at every associativity we report.
+    int sets = 1 << s;
+    vector<vector<unsigned int>> stacks(sets);
+
+    size_t length = trace.size();
+    DistinctCounter distinct(length);
+    unordered_map<unsigned int, size_t> lastUse; // block -> time of latest access
+
+    for (size_t t = 0; t < length; t++)
+    {
+        int addr = trace[t].address;
+        p.accesses++;
+
+        // Same decode as Simulator::run()
+        int index = (addr >> b) & ((1 << s) - 1);
+        unsigned int tag = addr >> (s + b);
+        vector<unsigned int> &stack = stacks[index];
+        size_t d = 0;
+        while (d < stack.size() && stack[d] != tag)
+            d++;
+        if (d < stack.size())
+        {
+            p.setHist[d]++;
+            stack.erase(stack.begin() + d);
+        }
+        else if ((int)stack.size() == maxE)
+        {
+            stack.pop_back();
+        }
+        stack.insert(stack.begin(), tag);
+
+        // Fully associative: distance = distinct blocks touched since the last use
+        unsigned int block = (unsigned int)addr >> b;
+        auto it = lastUse.find(block);
+        if (it != lastUse.end())
+        {
+            long long dist = distinct.prefix(t) - distinct.prefix(it->second + 1);
+            int bucket = 0;
+            while ((1LL << bucket) <= dist)
+                bucket++;
+            p.fullHist[bucket]++;
+            distinct.add(it->second, -1);
+            it->second = t;
+        }
+        else
+        {
+            lastUse.emplace(block, t);
+        }
+        distinct.add(t, 1);
+    }
+    return p;
+}
+
+void profileTraces(const vector<vector<TraceAccess>> &traces, int s, int b, int maxE, ostream &out)
+{
+    int numCores = traces.size();
+    vector<StackProfile> profiles;
+    StackProfile total;
+    total.setHist.assign(maxE, 0);
+    total.fullHist.assign(33, 0);
+    for (int i = 0; i < numCores; i++)
+    {
+        profiles.push_back(profileCore(traces[i], s, b, maxE));
+        total.accesses += profiles[i].accesses;
+        for (int d = 0; d < maxE; d++)
+            total.setHist[d] += profiles[i].setHist[d];
+        for (int k = 0; k < 33; k++)
+            total.fullHist[k] += profiles[i].fullHist[k];
+    }
+    profiles.push_back(total);
+
+    out << "\n===== Stack Distance Profile =====\n";
+    out << "Functional LRU profile of private caches: coherence (invalidations, sharing) is ignored.\n";
+    out << "Set Index Bits: " << s << "\n";
+    out << "Block Bits: " << b << "\n";
+    out << "Number of Sets: " << (1 << s) << "\n\n";
+
+    out << "Miss ratio (%) by associativity:\nE";
+    for (int i = 0; i < numCores; i++)
+        out << ",core" << i;
+    out << ",all,cache_bytes\n";
+    vector<long long> hits(profiles.size(), 0);
+    out << fixed << setprecision(5);
+    for (int e = 1; e <= maxE; e++)
+    {
+        out << e;
+        for (size_t i = 0; i < profiles.size(); i++)
+        {
+            hits[i] += profiles[i].setHist[e - 1];
+            long long n = profiles[i].accesses;
+            out << "," << (n > 0 ? (n - hits[i]) * 100.0 / n : 0.0);
+        }
+        out << "," << ((long long)e << (s + b)) << "\n";
+    }
+
+    out << "\nMiss ratio (%) of fully associative caches:\nblocks";
+    for (int i = 0; i < numCores; i++)
+        out << ",core" << i;
+    out << ",all,cache_bytes\n";
+    fill(hits.begin(), hits.end(), 0);
+    for (int k = 0; k < 32 - b; k++)
+    {
+        // A cache of 2^k blocks hits every reuse at distance < 2^k
+        for (size_t i = 0; i < profiles.size(); i++)
+            hits[i] += profiles[i].fullHist[k];
+        out << (1LL << k);
+        bool allCold = true;
+        for (size_t i = 0; i < profiles.size(); i++)
+        {
+            long long n = profiles[i].accesses;
+            long long reuses = 0;
+            for (long long h : profiles[i].fullHist)
+                reuses += h;
+            allCold = allCold && hits[i] == reuses;
+            out << "," << (n > 0 ? (n - hits[i]) * 100.0 / n : 0.0);
+        }
+        out << "," << (1LL << (k + b)) << "\n";
+        if (allCold)
+            break; // Only compulsory misses left
+    }
+}
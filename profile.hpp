@@ -0,0 +1,14 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <ostream>
+#include "main.hpp"
+
+// Functional miss-ratio profile (--profile): one pass per core computes LRU
+// stack distances (Mattson et al.) per set for the 2^s sets of 2^b-byte
+// blocks, and over all blocks for a fully associative cache. From these the
+// miss ratio of every associativity 1..maxE, and of fully associative caches
+// of any size, follows at once. Coherence is not modelled.
+void profileTraces(const vector<vector<TraceAccess>> &traces, int s, int b, int maxE, ostream &out);
+
+#endif // PROFILE_HPP
@@ -0,0 +1,348 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include "main.hpp"
+#include "sample.hpp"
+
+using namespace std;
+
+// Fills a line for a functionally warmed miss: like handle_read_miss() /
+// handle_write_miss(), but a dirty victim is written back at once.
+int Simulator::warmFill(int core, int index, int tag)
+{
+    Cache &cache = caches[core];
+    CacheLine *set = cache.set(index);
+    int way = -1;
+    for (int i = 0; i < E; i++)
+    {
+        if (set[i].state == MESIState::I)
+        {
+            way = i;
+            break;
+        }
+    }
+    if (way == -1)
+    {
+        way = cache.victim(index);
+        dirRemove(blockAddress(index, set[way].tag), core);
+        int victim = (set[way].tag << (s + b)) | (index << b);
+        if (set[way].dirty)
+            writebackStalls(core, victim, false);
+        else
+            cleanEviction(core, victim);
+    }
+    set[way].tag = tag;
+    set[way].prefetched = false;
+    cache.fill(index, way);
+    return way;
+}
+
+// One access with the state changes run() and bus() would make (in the L1s,
+// the sharer directory and the LLC), applied at once and without timing
+void Simulator::warmAccess(int core, const TraceAccess &entry)
+{
+    int addr = entry.address;
+    int index = (addr >> b) & ((1 << s) - 1);
+    int tag = addr >> (s + b);
+    Cache &cache = caches[core];
+    CacheLine *set = cache.set(index);
+    int way = findLine(core, index, tag);
+    if (way != -1 && (!entry.write || !sharedState(set[way].state)))
+    {
+        cache.touch(index, way);
+        if (entry.write)
+        {
+            set[way].dirty = true;
+            set[way].state = MESIState::M;
+        }
+        return;
+    }
+
+    unsigned int block = blockAddress(index, tag);
+    auto it = sharerDirectory.find(block);
+    unsigned long long others = (it == sharerDirectory.end()) ? 0 : it->second.sharers & ~(1ULL << core);
+    bool shared = others != 0;
+    if (!entry.write)
+    {
+        // BusRd: the owner, or (except under MESIF) the lowest numbered
+        // sharer, supplies the block; otherwise memory does
+        int i = -1;
+        if (others)
+        {
+            int owner = it->second.owner;
+            if (owner >= 0 && owner != core)
+                i = owner;
+            else if (protocol != Protocol::MESIF)
+                i = __builtin_ctzll(others);
+        }
+        if (i >= 0)
+        {
+            CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+            bool writeback;
+            line.state = readSnoopState(line.state, writeback);
+            if (writeback)
+                writebackStalls(i, addr, true);
+            if (line.state != MESIState::O)
+                dirClearOwner(block);
+        }
+        else
+        {
+            fetchStalls(core, addr);
+        }
+        way = warmFill(core, index, tag);
+        set[way].dirty = false;
+        set[way].state = readFillState(shared);
+        dirAdd(block, core, set[way].state != MESIState::S);
+        return;
+    }
+
+    // BusRdX or BusUpgr: Dragon updates the other copies, the other
+    // protocols invalidate them (MOESI hands a dirty block over instead of
+    // writing it back)
+    bool update = protocol == Protocol::Dragon;
+    bool supplied = update && shared;
+    for (int i = 0; others; i++, others >>= 1)
+    {
+        if (!(others & 1))
+            continue;
+        CacheLine &line = caches[i].set(index)[findLine(i, index, tag)];
+        if (update)
+        {
+            line.state = MESIState::S;
+            continue;
+        }
+        if (line.state == MESIState::M || line.state == MESIState::O)
+        {
+            if (protocol == Protocol::MOESI)
+                supplied = true;
+            else
+                writebackStalls(i, addr, false);
+        }
+        line.state = MESIState::I;
+        dirRemove(block, i);
+    }
+    if (update)
+        dirClearOwner(block);
+    if (way == -1)
+    {
+        if (!supplied)
+            fetchStalls(core, addr);
+        way = warmFill(core, index, tag);
+    }
+    else
+    {
+        cache.touch(index, way);
+    }
+    set[way].dirty = true;
+    set[way].state = writeFillState(update && shared);
+    dirAdd(block, core, true);
+}
+
+// Leaves detailed simulation. Queued misses are dropped: their cores have
+// not executed those accesses yet and will warm them. A queued upgrade is for
+// a write its core has already retired, so it is applied here. Transfers in
+// flight are abandoned; the snooped caches have already been updated, and a
+// requester that was waiting for data repeats its access functionally.
+void Simulator::dropBusState()
+{
+    for (size_t k = 0; k < busQueue.size(); k++)
+    {
+        if (busQueue[k].type == BusReqType::BusUpgr)
+        {
+            warmAccess(busQueue[k].coreId, TraceAccess{(unsigned int)busQueue[k].address, true});
+        }
+    }
+    // Misses a non-blocking cache already retired still get their blocks
+    for (int i = 0; i < numCores; i++)
+    {
+        for (const Mshr &reg : caches[i].mshrs)
+        {
+            warmAccess(i, TraceAccess{reg.block << b, reg.write});
+        }
+        caches[i].mshrs.clear();
+        prefetchPending[i].clear();
+        for (int store : storeBuffers[i])
+        {
+            warmAccess(i, TraceAccess{(unsigned int)store, true});
+        }
+        storeBuffers[i].clear();
+        storeInFlight[i] = false;
+    }
+    busQueue.clear();
+    busDataQueue.clear();
+    bus_busy = false;
+    for (int i = 0; i < numCores; i++)
+    {
+        caches[i].stall = false;
+        waitingForBus[i] = false;
+        corePendingOperation[i] = -1;
+    }
+}
+
+bool parseSampleSpec(const string &spec, SampleSpec &sample)
+{
+    sample.window = 1000;
+    sample.warmup = 500;
+    char sep1 = ':', sep2 = ':';
+    istringstream in(spec);
+    if (!(in >> sample.interval))
+    {
+        return false;
+    }
+    if (in >> sep1 && !(sep1 == ':' && in >> sample.window))
+    {
+        return false;
+    }
+    if (in >> sep2 && !(sep2 == ':' && in >> sample.warmup))
+    {
+        return false;
+    }
+    char extra;
+    if (in >> extra)
+    {
+        return false;
+    }
+    return sample.window > 0 && sample.warmup >= 0 && sample.interval >= sample.window + sample.warmup;
+}
+
+namespace
+{
+
+// One measured window, normalised per access
+struct SampleWindow
+{
+    double cyclesPerAccess; // Cycles per access retired by all cores together
+    long long periodAccesses; // Accesses of its whole period, warmed and detailed
+    double missRate;
+    double bytesPerAccess;
+};
+
+long long sum(const vector<int> &values)
+{
+    long long total = 0;
+    for (int v : values)
+        total += v;
+    return total;
+}
+
+// Mean of the samples and the half-width of its 95% confidence interval
+void estimate(const vector<SampleWindow> &windows, double SampleWindow::*field, double &mean, double &half)
+{
+    size_t n = windows.size();
+    mean = 0;
+    for (const SampleWindow &w : windows)
+        mean += w.*field;
+    mean /= n;
+    double var = 0;
+    for (const SampleWindow &w : windows)
+        var += (w.*field - mean) * (w.*field - mean);
+    half = n > 1 ? 1.96 * sqrt(var / (n - 1) / n) : 0;
+}
+
+void printEstimate(ostream &out, const char *name, double mean, double half, double scale)
+{
+    out << name << ": " << mean * scale << " +/- " << half * scale;
+    if (mean > 0)
+    {
+        out << " (" << 100.0 * half / mean << "%)";
+    }
+    out << "\n";
+}
+
+} // namespace
+
+void runSampled(Simulator &sim, const SampleSpec &spec, ostream &out)
+{
+    const vector<vector<TraceAccess>> &traces = *sim.traces;
+    long long totalAccesses = 0;
+    for (int i = 0; i < sim.numCores; i++)
+    {
+        totalAccesses += traces[i].size();
+        sim.coreActive[i] = !traces[i].empty();
+    }
+
+    vector<SampleWindow> windows;
+    long long detailed = 0;
+    bool more = true;
+    while (more)
+    {
+        long long periodStart = 0;
+        for (size_t pos : sim.tracePos)
+            periodStart += pos;
+        // Functional warming up to the detailed part of the period
+        for (long long n = 0; n < spec.interval - spec.warmup - spec.window; n++)
+        {
+            bool any = false;
+            for (int i = 0; i < sim.numCores; i++)
+            {
+                if (sim.coreActive[i])
+                {
+                    sim.warmAccess(i, traces[i][sim.tracePos[i]]);
+                    sim.coreActive[i] = ++sim.tracePos[i] < traces[i].size();
+                    any = true;
+                }
+            }
+            if (!any)
+                break;
+        }
+        int active = (int)count(sim.coreActive.begin(), sim.coreActive.end(), true);
+        if (active == 0)
+            break;
+
+        // Detailed warm-up, then the measured window
+        long long start = sum(sim.instructions);
+        while (more && sum(sim.instructions) - start < spec.warmup * active)
+            more = sim.step(nullptr);
+        long long cycles = sim.globalCycle;
+        long long executed = sum(sim.instructions);
+        long long misses = sum(sim.cache_misses);
+        long long bytes = sim.total_bus_traffic_bytes;
+        while (more && sum(sim.instructions) - executed < spec.window * active)
+            more = sim.step(nullptr);
+        long long n = sum(sim.instructions) - executed;
+        long long periodAccesses = -periodStart;
+        for (size_t pos : sim.tracePos)
+            periodAccesses += pos;
+        if (n >= spec.window * active)
+        {
+            // Windows cut short by the end of the traces are not used
+            windows.push_back(SampleWindow{(double)(sim.globalCycle - cycles) / n, periodAccesses,
+                                           (double)(sum(sim.cache_misses) - misses) / n,
+                                           (double)(sim.total_bus_traffic_bytes - bytes) / n});
+        }
+        detailed += sum(sim.instructions) - start;
+        sim.dropBusState();
+        more = count(sim.coreActive.begin(), sim.coreActive.end(), true) > 0;
+    }
+
+    out << "\n===== Sampled Estimates =====\n";
+    out << "Samples: " << windows.size() << " (window " << spec.window << ", warm-up " << spec.warmup
+        << ", period " << spec.interval << " accesses per core)\n";
+    if (windows.size() < 2)
+    {
+        out << "Too few samples for an estimate; use a shorter period.\n";
+        return;
+    }
+    out << fixed << setprecision(2);
+    out << "Accesses Simulated in Detail (%): " << 100.0 * detailed / totalAccesses << "\n";
+    out << "Confidence Level: 95%\n";
+    // Each window's cycles per access stand for its whole period, so the
+    // periods are weighted by their accesses: while the bus limits the run,
+    // cores that finish early do not make the rest cheaper, and while it does
+    // not, a period of fewer running cores costs correspondingly more
+    double meanAccesses = 0;
+    for (const SampleWindow &w : windows)
+        meanAccesses += w.periodAccesses;
+    meanAccesses /= windows.size();
+    for (SampleWindow &w : windows)
+        w.cyclesPerAccess *= w.periodAccesses / meanAccesses;
+    double mean, half;
+    estimate(windows, &SampleWindow::cyclesPerAccess, mean, half);
+    printEstimate(out, "Execution Time (cycles)", mean, half, (double)totalAccesses);
+    estimate(windows, &SampleWindow::missRate, mean, half);
+    printEstimate(out, "Cache Miss Rate (%)", mean, half, 100.0);
+    estimate(windows, &SampleWindow::bytesPerAccess, mean, half);
+    printEstimate(out, "Bus Traffic (Bytes)", mean, half, (double)totalAccesses);
+}
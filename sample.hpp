@@ -0,0 +1,28 @@
+#ifndef SAMPLE_HPP
+#define SAMPLE_HPP
+
+#include <string>
+#include <ostream>
+#include "main.hpp"
+
+// Sampled simulation (--sample), after SMARTS (Wunderlich et al.): the
+// traces are split into periods of interval accesses per core. Most of a
+// period is fast-forwarded with functional warming (cache tags, replacement
+// and MESI states kept up to date, no bus timing); its last warmup + window
+// accesses are simulated in detail and only the final window is measured.
+struct SampleSpec
+{
+    long long interval;
+    long long window;
+    long long warmup;
+};
+
+// "interval[:window[:warmup]]", accesses per core (window defaults to 1000,
+// warmup to 500)
+bool parseSampleSpec(const string &spec, SampleSpec &sample);
+
+// Runs the sampled simulation and prints the estimates with their 95%
+// confidence intervals
+void runSampled(Simulator &sim, const SampleSpec &spec, ostream &out);
+
+#endif // SAMPLE_HPP
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "main.hpp"
+#include "sharing.hpp"
+
+using namespace std;
+
+static SharingBlock &sharingEntry(unordered_map<unsigned int, SharingBlock> &blocks, unsigned int block)
+{
+    return blocks.emplace(block, SharingBlock{0, 0, 0, 0, 0, -1, 0}).first->second;
+}
+
+// A retired access; runs on the core's own thread under --parallel, so only
+// that core's map is touched
+void Simulator::sharingAccess(int core, const TraceAccess &entry)
+{
+    int shift = b > 6 ? b - 6 : 0;
+    int slot = (int)((entry.address & ((1u << b) - 1)) >> shift);
+    SharingTouch &touch = sharingTouches[core][entry.address >> b];
+    if (entry.write)
+    {
+        touch.written |= 1ULL << slot;
+    }
+    else
+    {
+        touch.read |= 1ULL << slot;
+    }
+}
+
+// A granted request and the bus cycles of the transfers it started. A miss
+// of a copy another core invalidated is a coherence miss; it and an upgrade
+// exist only because the block is shared. A BusRdX or BusUpgr moves write
+// ownership to the requester.
+void Simulator::sharingGrant(int core, int addr, BusReqType type, bool prefetch, int cycles)
+{
+    SharingBlock &entry = sharingEntry(sharingBlocks, (unsigned int)addr >> b);
+    bool coherenceMiss = (entry.lostTo >> core) & 1;
+    entry.lostTo &= ~(1ULL << core);
+    if (prefetch)
+    {
+        return;
+    }
+    if (coherenceMiss)
+    {
+        entry.coherenceMisses++;
+    }
+    if (type == BusReqType::BusUpgr)
+    {
+        entry.upgrades++;
+    }
+    if (coherenceMiss || type == BusReqType::BusUpgr)
+    {
+        entry.coherenceCycles += cycles;
+    }
+    if (type != BusReqType::BusRd)
+    {
+        if (entry.lastOwner >= 0 && entry.lastOwner != core)
+        {
+            entry.ownerChanges++;
+        }
+        entry.lastOwner = core;
+    }
+}
+
+// Another core's BusRdX or BusUpgr invalidated a core's copy
+void Simulator::sharingInvalidate(int core, unsigned int block)
+{
+    SharingBlock &entry = sharingEntry(sharingBlocks, block);
+    entry.invalidations++;
+    entry.lostTo |= 1ULL << core;
+}
+
+// Offsets one core touched, as runs of neighbouring slots with the same use
+static string sharingOffsets(const SharingTouch &touch, int shift)
+{
+    string text;
+    // 1 read, 2 written, 3 both
+    auto kindAt = [&touch](int slot)
+    { return (int)((touch.read >> slot) & 1) | (int)((touch.written >> slot) & 1) << 1; };
+    int slot = 0;
+    while (slot < SHARING_SLOTS)
+    {
+        int kind = kindAt(slot);
+        if (kind == 0)
+        {
+            slot++;
+            continue;
+        }
+        int end = slot;
+        while (end + 1 < SHARING_SLOTS && kindAt(end + 1) == kind)
+        {
+            end++;
+        }
+        if (!text.empty())
+        {
+            text += ", ";
+        }
+        text += to_string(slot << shift);
+        if (end > slot || shift > 0)
+        {
+            text += "-" + to_string(((end + 1) << shift) - 1);
+        }
+        text += kind == 1 ? " r" : kind == 2 ? " w" : " rw";
+        slot = end + 1;
+    }
+    return text;
+}
+
+void Simulator::printSharing(ostream &out)
+{
+    int shift = b > 6 ? b - 6 : 0;
+    struct Line
+    {
+        unsigned int block;
+        const SharingBlock *entry;
+        bool falseSharing;
+    };
+    vector<Line> lines;
+    long long falseLines = 0, savedCycles = 0;
+    for (const auto &item : sharingBlocks)
+    {
+        const SharingBlock &entry = item.second;
+        if (entry.ownerChanges == 0 && entry.invalidations == 0)
+        {
+            continue;
+        }
+        // Falsely shared: several cores touch the block, and none of them
+        // touches an offset that another one writes
+        int touching = 0;
+        bool overlap = false;
+        for (int i = 0; i < numCores; i++)
+        {
+            auto mine = sharingTouches[i].find(item.first);
+            if (mine == sharingTouches[i].end())
+            {
+                continue;
+            }
+            touching++;
+            for (int j = 0; j < numCores && !overlap; j++)
+            {
+                auto theirs = sharingTouches[j].find(item.first);
+                if (j != i && theirs != sharingTouches[j].end() &&
+                    (mine->second.written & (theirs->second.read | theirs->second.written)) != 0)
+                {
+                    overlap = true;
+                }
+            }
+        }
+        bool falseSharing = touching > 1 && !overlap;
+        if (falseSharing)
+        {
+            falseLines++;
+            savedCycles += entry.coherenceCycles;
+        }
+        lines.push_back(Line{item.first, &entry, falseSharing});
+    }
+    sort(lines.begin(), lines.end(), [](const Line &x, const Line &y)
+         {
+             if (x.entry->ownerChanges != y.entry->ownerChanges)
+                 return x.entry->ownerChanges > y.entry->ownerChanges;
+             if (x.entry->invalidations != y.entry->invalidations)
+                 return x.entry->invalidations > y.entry->invalidations;
+             return x.block < y.block; });
+
+    out << "\n===== False Sharing =====\n";
+    out << "Lines Invalidated or Changing Owner: " << lines.size() << "\n";
+    out << "Falsely Shared Lines: " << falseLines << "\n";
+    out << "Est. Cycles Saved by Padding Them: " << savedCycles << "\n";
+    int shown = min((int)lines.size(), sharingTop);
+    if (shown > 0)
+    {
+        out << "Top " << shown << " Lines by Ownership Ping-Pong:\n";
+    }
+    for (int k = 0; k < shown; k++)
+    {
+        const Line &line = lines[k];
+        const SharingBlock &entry = *line.entry;
+        out << "Block 0x" << hex << setw(8) << setfill('0') << (line.block << b) << dec << setfill(' ') << ": "
+            << (line.falseSharing ? "false sharing" : "true sharing") << "\n";
+        out << "  Ownership Changes: " << entry.ownerChanges << ", Invalidations: " << entry.invalidations
+            << ", Coherence Misses: " << entry.coherenceMisses << ", Upgrades: " << entry.upgrades
+            << ", Coherence Cycles: " << entry.coherenceCycles << "\n";
+        for (int i = 0; i < numCores; i++)
+        {
+            auto touch = sharingTouches[i].find(line.block);
+            if (touch != sharingTouches[i].end())
+            {
+                out << "  Core " << i << " offsets: " << sharingOffsets(touch->second, shift) << "\n";
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SHARING_HPP
+#define SHARING_HPP
+
+// False-sharing analysis (--sharing n). Every core records which offsets of
+// each block it read and wrote; the bus records, per block, how often write
+// ownership moved to another core, the copies it invalidated and what the
+// misses and upgrades those invalidations caused cost. A line whose cores
+// never touch an offset that another core writes is falsely shared: padding
+// its cores' data into separate blocks removes that traffic.
+
+const int SHARING_SLOTS = 64; // Offset slots per block (a byte each up to 64-byte blocks)
+
+// Offsets of a block one core touched, one bit per slot
+struct SharingTouch
+{
+    unsigned long long read;
+    unsigned long long written;
+};
+
+// Coherence traffic of one block
+struct SharingBlock
+{
+    long long ownerChanges;     // BusRdX/BusUpgr that took write ownership from another core
+    long long invalidations;    // Copies invalidated by another core's write
+    long long coherenceMisses;  // Misses on a copy invalidated that way
+    long long upgrades;         // BusUpgr of shared copies
+    long long coherenceCycles;  // Bus cycles of the transfers of those misses and upgrades
+    int lastOwner;              // Core that last took write ownership, or -1
+    unsigned long long lostTo;  // Cores whose copy was invalidated and not fetched again
+};
+
+#endif // SHARING_HPP
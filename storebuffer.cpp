@@ -0,0 +1,165 @@
+#include <algorithm>
+#include "main.hpp"
+
+using namespace std;
+
+// A write under --store-buffer. With an empty buffer a write to a block the
+// core may modify at once (E or M) goes straight to the cache as before and
+// false is returned. Any other write is queued behind the earlier ones, or
+// stalls the core while the buffer is full.
+bool Simulator::storeWrite(int core, int addr)
+{
+    vector<int> &buffer = storeBuffers[core];
+    if (buffer.empty())
+    {
+        int index = (addr >> b) & ((1 << s) - 1);
+        int tag = addr >> (s + b);
+        int way = findLine(core, index, tag);
+        if (way != -1)
+        {
+            MESIState state = caches[core].set(index)[way].state;
+            if (state == MESIState::E || state == MESIState::M)
+            {
+                return false;
+            }
+        }
+    }
+    if ((int)buffer.size() == storeBufferDepth)
+    {
+        caches[core].stall = true;
+        clockCycles[core]++;
+        idle_cycles[core]++;
+        storeFullCycles[core]++;
+        return true;
+    }
+    buffer.push_back(addr);
+    storesBuffered[core]++;
+    storePeak[core] = max(storePeak[core], (int)buffer.size());
+    return true;
+}
+
+// A read that finds the address in the store buffer takes the newest value
+// from there. A read of another word of a buffered block that is not cached
+// waits until the block's stores drain, so the core never has two fetches of
+// one block in flight. Returns whether the read was handled here.
+bool Simulator::storeLoad(int core, int addr, bool cached)
+{
+    const vector<int> &buffer = storeBuffers[core];
+    bool sameBlock = false;
+    for (size_t k = buffer.size(); k-- > 0;)
+    {
+        if (buffer[k] == addr)
+        {
+            storeForwards[core]++;
+            return true;
+        }
+        sameBlock = sameBlock || ((unsigned int)buffer[k] >> b) == ((unsigned int)addr >> b);
+    }
+    if (sameBlock && !cached)
+    {
+        caches[core].stall = true;
+        clockCycles[core]++;
+        idle_cycles[core]++;
+        return true;
+    }
+    return false;
+}
+
+// One cycle of draining a core's store buffer: the oldest store is written
+// into the cache if the core holds its block in E or M, otherwise it issues
+// the BusRdX or BusUpgr it needs (once no other fetch of the block is
+// pending) and completes when that transfer does.
+void Simulator::storeDrain(int core)
+{
+    vector<int> &buffer = storeBuffers[core];
+    if (buffer.empty() || storeInFlight[core])
+    {
+        return;
+    }
+    int addr = buffer.front();
+    unsigned int block = (unsigned int)addr >> b;
+    int index = (addr >> b) & ((1 << s) - 1);
+    int tag = addr >> (s + b);
+    Cache &cache = caches[core];
+    int way = findLine(core, index, tag);
+    if (way != -1)
+    {
+        CacheLine &line = cache.set(index)[way];
+        if (line.state == MESIState::E || line.state == MESIState::M)
+        {
+            cache.touch(index, way);
+            line.dirty = true;
+            line.state = MESIState::M;
+            if (line.prefetched)
+            {
+                prefetchUsed(core, addr, line);
+            }
+            if (classifyMisses)
+            {
+                classifyAccess(core, TraceAccess{(unsigned int)addr, true});
+            }
+            buffer.erase(buffer.begin());
+            return;
+        }
+    }
+    for (const Mshr &reg : cache.mshrs)
+    {
+        if (reg.block == block)
+            return;
+    }
+    for (const PrefetchPending &p : prefetchPending[core])
+    {
+        if (p.block == block)
+            return;
+    }
+    if (way != -1 && cache.set(index)[way].prefetched)
+    {
+        prefetchUsed(core, addr, cache.set(index)[way]);
+    }
+    if (classifyMisses)
+    {
+        if (way == -1)
+        {
+            classifyIssue(core, addr);
+        }
+        classifyAccess(core, TraceAccess{(unsigned int)addr, true});
+    }
+    BusReq req{core, addr, way == -1 ? BusReqType::BusRdX : BusReqType::BusUpgr, cycle};
+    req.mshr = true;
+    req.store = true;
+    busRequest(req);
+    storeInFlight[core] = true;
+}
+
+// The bus transfer of the oldest store has completed, and with it the store
+void Simulator::storeRetire(int core)
+{
+    vector<int> &buffer = storeBuffers[core];
+    if (!buffer.empty())
+    {
+        buffer.erase(buffer.begin());
+    }
+    storeInFlight[core] = false;
+}
+
+void Simulator::storeTick(int cycles)
+{
+    for (int i = 0; i < numCores; i++)
+    {
+        storeOccupancy[i] += (long long)storeBuffers[i].size() * cycles;
+    }
+}
+
+// Whether no store buffer can change anything until a bus transfer ends:
+// each one is empty or waiting for its oldest store's transfer
+bool Simulator::storesQuiet()
+{
+    for (int i = 0; i < numCores; i++)
+    {
+        if (!storeBuffers[i].empty() && !storeInFlight[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cctype>
+#include "sweep.hpp"
+#include "coherence.hpp"
+#include "prefetch.hpp"
+
+using namespace std;
+
+// Aggregated results of one simulation
+struct SweepResult
+{
+    SweepPoint point;
+    long long maxtime;
+    long long instructions, reads, writes, misses, evictions, writebacks, invalidations, idle;
+    long long busTransactions, busTraffic;
+    double busUtilization;
+};
+
+static bool parseRange(const string &text, vector<int> &values)
+{
+    int lo, hi, step = 1;
+    char c1, c2;
+    istringstream in(text);
+    if (!(in >> lo))
+        return false;
+    hi = lo;
+    if (in >> c1)
+    {
+        if (c1 != ':' || !(in >> hi))
+            return false;
+        if (in >> c2 && (c2 != ':' || !(in >> step) || step <= 0))
+            return false;
+    }
+    for (int v = lo; v <= hi; v += step)
+        values.push_back(v);
+    return !values.empty();
+}
+
+static bool parseGroup(string group, const SweepPoint &defaults, vector<SweepPoint> &points)
+{
+    for (char &c : group)
+        if (c == ',' || c == '\t' || c == '\r')
+            c = ' ';
+    istringstream in(group);
+    vector<string> tokens;
+    string token;
+    while (in >> token)
+        tokens.push_back(token);
+    if (tokens.empty() || tokens[0][0] == '#')
+        return true;
+
+    vector<int> sv, ev, bv;
+    if (tokens.size() == 3 && tokens[0].find('=') == string::npos)
+    {
+        sv.push_back(atoi(tokens[0].c_str()));
+        ev.push_back(atoi(tokens[1].c_str()));
+        bv.push_back(atoi(tokens[2].c_str()));
+    }
+    else
+    {
+        for (const string &t : tokens)
+        {
+            size_t eq = t.find('=');
+            if (eq == string::npos)
+                return false;
+            string key = t.substr(0, eq);
+            vector<int> *target = key == "s" ? &sv : key == "E" ? &ev : key == "b" ? &bv : nullptr;
+            if (!target || !parseRange(t.substr(eq + 1), *target))
+                return false;
+        }
+    }
+    if (sv.empty())
+        sv.push_back(defaults.s);
+    if (ev.empty())
+        ev.push_back(defaults.E);
+    if (bv.empty())
+        bv.push_back(defaults.b);
+
+    for (int s : sv)
+        for (int E : ev)
+            for (int b : bv)
+            {
+                if (s < 0 || E < 1 || b < 1 || s + b >= 32)
+                    return false;
+                points.push_back(SweepPoint{s, E, b});
+            }
+    return true;
+}
+
+bool parseSweepSpec(const string &spec, const SweepPoint &defaults, vector<SweepPoint> &points)
+{
+    string text = spec;
+    ifstream file(spec);
+    if (file.is_open())
+    {
+        text.assign((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    }
+    for (char &c : text)
+        if (c == ';')
+            c = '\n';
+
+    istringstream in(text);
+    string group;
+    while (getline(in, group))
+    {
+        if (!parseGroup(group, defaults, points))
+        {
+            cerr << "Error: Bad sweep group \"" << group << "\"" << endl;
+            return false;
+        }
+    }
+    return !points.empty();
+}
+
+static SweepResult simulatePoint(const SweepPoint &p, const vector<vector<TraceAccess>> &traces, int numCores,
+                                 const SweepConfig &config)
+{
+    unique_ptr<Simulator> sim(new Simulator(p.s, p.b, p.E, numCores, config.policy));
+    sim->eventDriven = config.eventDriven;
+    sim->protocol = config.protocol;
+    sim->splitOutstanding = config.splitOutstanding;
+    sim->mshrCount = config.mshrCount;
+    sim->prefetcher = config.prefetcher;
+    sim->prefetchDegree = config.prefetchDegree;
+    sim->storeBufferDepth = config.storeBufferDepth;
+    sim->traces = &traces;
+    sim->simulate();
+
+    SweepResult r = {};
+    r.point = p;
+    r.maxtime = sim->maxtime;
+    for (int i = 0; i < numCores; i++)
+    {
+        r.instructions += sim->instructions[i];
+        r.reads += sim->num_reads[i];
+        r.writes += sim->num_writes[i];
+        r.misses += sim->cache_misses[i];
+        r.evictions += sim->cache_evictions[i];
+        r.writebacks += sim->writebacks[i];
+        r.invalidations += sim->bus_invalidations[i];
+        r.idle += sim->idle_cycles[i];
+    }
+    r.busTransactions = sim->total_bus_transactions;
+    r.busTraffic = sim->total_bus_traffic_bytes;
+    r.busUtilization = sim->globalCycle > 0 ? sim->busBusyCycles * 100.0 / sim->globalCycle : 0.0;
+    return r;
+}
+
+static void writeResults(ostream &out, const vector<SweepResult> &results, const SweepConfig &config, bool json)
+{
+    static const char *columns[] = {"s", "E", "b", "cache_bytes", "max_execution_cycles", "instructions", "reads",
+                                    "writes", "misses", "miss_rate", "evictions", "writebacks", "invalidations",
+                                    "idle_cycles", "bus_transactions", "bus_traffic_bytes", "bus_utilization",
+                                    "protocol", "split_outstanding", "mshrs", "prefetcher", "prefetch_degree",
+                                    "store_buffer", "replacement"};
+    const int numColumns = sizeof(columns) / sizeof(columns[0]);
+
+    if (json)
+        out << "[\n";
+    else
+    {
+        for (int c = 0; c < numColumns; c++)
+            out << (c ? "," : "") << columns[c];
+        out << "\n";
+    }
+
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        const SweepResult &r = results[k];
+        long long accesses = r.reads + r.writes;
+        ostringstream missRate, utilization;
+        missRate << (accesses > 0 ? r.misses * 100.0 / accesses : 0.0);
+        utilization << r.busUtilization;
+        string values[] = {to_string(r.point.s), to_string(r.point.E), to_string(r.point.b),
+                           to_string((1LL << r.point.s) * r.point.E * (1LL << r.point.b)), to_string(r.maxtime),
+                           to_string(r.instructions), to_string(r.reads), to_string(r.writes), to_string(r.misses),
+                           missRate.str(), to_string(r.evictions), to_string(r.writebacks),
+                           to_string(r.invalidations), to_string(r.idle), to_string(r.busTransactions),
+                           to_string(r.busTraffic), utilization.str(), protocolName(config.protocol),
+                           to_string(config.splitOutstanding), to_string(config.mshrCount),
+                           prefetchKindName(config.prefetcher), to_string(config.prefetchDegree),
+                           to_string(config.storeBufferDepth), replPolicyName(config.policy)};
+        if (json)
+        {
+            // Numbers are written bare, names as strings
+            out << "  {";
+            for (int c = 0; c < numColumns; c++)
+            {
+                bool name = isalpha((unsigned char)values[c][0]);
+                out << (c ? ", " : "") << "\"" << columns[c] << "\": " << (name ? "\"" : "") << values[c]
+                    << (name ? "\"" : "");
+            }
+            out << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+        }
+        else
+        {
+            for (int c = 0; c < numColumns; c++)
+                out << (c ? "," : "") << values[c];
+            out << "\n";
+        }
+    }
+    if (json)
+        out << "]\n";
+}
+
+bool runSweep(const vector<SweepPoint> &points, const vector<vector<TraceAccess>> &traces, int numCores,
+              const SweepConfig &config, int threads, const string &outfilename)
+{
+    if (threads <= 0)
+    {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = min<int>(threads, points.size());
+
+    // Workers pull the next point until none are left; results keep the spec order
+    vector<SweepResult> results(points.size());
+    atomic<size_t> next(0);
+    mutex progressLock;
+    size_t done = 0;
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]()
+                          {
+            for (size_t k = next++; k < points.size(); k = next++)
+            {
+                results[k] = simulatePoint(points[k], traces, numCores, config);
+                lock_guard<mutex> guard(progressLock);
+                cerr << "\r[" << ++done << "/" << points.size() << "] s=" << points[k].s << " E=" << points[k].E
+                     << " b=" << points[k].b << "      " << flush;
+            } });
+    }
+    for (thread &t : pool)
+    {
+        t.join();
+    }
+    cerr << endl;
+
+    if (outfilename.empty())
+    {
+        writeResults(cout, results, config, false);
+        return true;
+    }
+    ofstream out(outfilename);
+    if (!out.is_open())
+    {
+        cerr << "Error: Could not open output file " << outfilename << endl;
+        return false;
+    }
+    bool json = outfilename.size() >= 5 && outfilename.compare(outfilename.size() - 5, 5, ".json") == 0;
+    writeResults(out, results, config, json);
+    return true;
+}
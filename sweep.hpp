@@ -0,0 +1,41 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include "main.hpp"
+
+// One cache geometry in a parameter sweep
+struct SweepPoint
+{
+    int s;
+    int E;
+    int b;
+};
+
+// Simulator settings shared by every point of a sweep
+struct SweepConfig
+{
+    ReplPolicy policy;
+    bool eventDriven;
+    Protocol protocol;
+    int splitOutstanding;
+    int mshrCount;
+    PrefetchKind prefetcher;
+    int prefetchDegree;
+    int storeBufferDepth;
+};
+
+// Parses a sweep specification: either the name of a file or an inline
+// string. Groups are separated by newlines or ';'. A group is either three
+// numbers "s E b" or ranges such as "s=1:11 E=2 b=5" (lo:hi[:step], separated
+// by spaces or commas); parameters a group leaves out take the defaults.
+bool parseSweepSpec(const string &spec, const SweepPoint &defaults, vector<SweepPoint> &points);
+
+// Simulates every point on a pool of threads, all sharing the decoded traces,
+// and writes one results table (JSON if outfilename ends in .json, CSV
+// otherwise; stdout when outfilename is empty).
+bool runSweep(const vector<SweepPoint> &points, const vector<vector<TraceAccess>> &traces, int numCores,
+              const SweepConfig &config, int threads, const string &outfilename);
+
+#endif // SWEEP_HPP
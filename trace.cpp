@@ -0,0 +1,470 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.hpp"
+
+using namespace std;
+
+bool parseTraceLine(const char *p, const char *end, TraceAccess &out)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (p == end)
+        return false;
+
+    // Only process read (R) and write (W) operations; comments start with '#'
+    char op = *p++;
+    if (op != 'R' && op != 'W')
+        return false;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    // Address is hex with an optional 0x prefix
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+    unsigned int addr = 0;
+    const char *digits = p;
+    while (p < end)
+    {
+        char c = *p;
+        int v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            break;
+        addr = (addr << 4) | v;
+        p++;
+    }
+    if (p == digits)
+        return false;
+
+    out.address = addr;
+    out.write = (op == 'W');
+    return true;
+}
+
+bool loadTextTrace(const string &filename, vector<TraceAccess> &out)
+{
+    ifstream traceFile(filename);
+    if (!traceFile.is_open())
+    {
+        cerr << "Error: Could not open trace file " << filename << endl;
+        return false;
+    }
+
+    out.clear();
+    string line;
+    while (getline(traceFile, line))
+    {
+        // Decode line like "R 0x817b08" once, straight into a packed record
+        TraceAccess access;
+        if (parseTraceLine(line.data(), line.data() + line.size(), access))
+        {
+            out.push_back(access);
+        }
+    }
+    return true;
+}
+
+// ---- Binary trace format ----
+
+static const char BTRACE_MAGIC[4] = {'L', '1', 'T', 'B'};
+static const unsigned char BTRACE_VERSION = 1;
+static const size_t BTRACE_BLOCK = 4096; // Accesses per RLE block
+
+static void putVarint(string &buf, unsigned long long v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((char)v);
+}
+
+static bool getVarint(const unsigned char *&p, const unsigned char *end, unsigned long long &v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        unsigned char c = *p++;
+        v |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void putFixed(string &buf, unsigned long long v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        buf.push_back((char)(v >> (8 * i)));
+}
+
+static unsigned long long getFixed(const unsigned char *p, int bytes)
+{
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (unsigned long long)p[i] << (8 * i);
+    return v;
+}
+
+// Record for one access relative to the previous address of the same core
+static unsigned long long encodeAccess(const TraceAccess &a, unsigned int prev)
+{
+    int delta = (int)(a.address - prev);
+    unsigned int zigzag = ((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31);
+    return ((unsigned long long)zigzag << 1) | (a.write ? 1 : 0);
+}
+
+static TraceAccess decodeAccess(unsigned long long record, unsigned int prev)
+{
+    unsigned int zigzag = (unsigned int)(record >> 1);
+    int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+    return TraceAccess{prev + (unsigned int)delta, (record & 1) != 0};
+}
+
+static void encodePlain(const vector<TraceAccess> &trace, string &out)
+{
+    unsigned int prev = 0;
+    for (const TraceAccess &a : trace)
+    {
+        putVarint(out, encodeAccess(a, prev));
+        prev = a.address;
+    }
+}
+
+static bool decodePlain(const unsigned char *p, const unsigned char *end, size_t count, vector<TraceAccess> &out)
+{
+    unsigned int prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long record;
+        if (!getVarint(p, end, record))
+            return false;
+        TraceAccess a = decodeAccess(record, prev);
+        out.push_back(a);
+        prev = a.address;
+    }
+    return p == end;
+}
+
+// Block layout: varint(accesses), varint(bytes), then tokens of
+// varint(record << 1 | repeated) [varint(run - 2) if repeated].
+static void encodeBlocks(const vector<TraceAccess> &trace, string &out)
+{
+    for (size_t start = 0; start < trace.size(); start += BTRACE_BLOCK)
+    {
+        size_t stop = min(trace.size(), start + BTRACE_BLOCK);
+        string block;
+        unsigned int prev = 0; // Deltas restart in every block
+        size_t i = start;
+        while (i < stop)
+        {
+            unsigned long long record = encodeAccess(trace[i], prev);
+            prev = trace[i].address;
+            size_t run = 1;
+            while (i + run < stop && encodeAccess(trace[i + run], prev) == record)
+            {
+                prev = trace[i + run].address;
+                run++;
+            }
+            putVarint(block, (record << 1) | (run > 1 ? 1 : 0));
+            if (run > 1)
+                putVarint(block, run - 2);
+            i += run;
+        }
+        putVarint(out, stop - start);
+        putVarint(out, block.size());
+        out += block;
+    }
+}
+
+static bool decodeBlocks(const unsigned char *p, const unsigned char *end, size_t count, vector<TraceAccess> &out)
+{
+    while (p < end)
+    {
+        unsigned long long accesses, bytes;
+        if (!getVarint(p, end, accesses) || !getVarint(p, end, bytes) || bytes > (unsigned long long)(end - p))
+            return false;
+        const unsigned char *blockEnd = p + bytes;
+        unsigned int prev = 0;
+        size_t decoded = 0;
+        while (p < blockEnd)
+        {
+            unsigned long long token, extra = 0;
+            if (!getVarint(p, blockEnd, token) || ((token & 1) && !getVarint(p, blockEnd, extra)))
+                return false;
+            size_t run = (token & 1) ? extra + 2 : 1;
+            if (run > count - out.size())
+                return false;
+            for (size_t r = 0; r < run; r++)
+            {
+                TraceAccess a = decodeAccess(token >> 1, prev);
+                out.push_back(a);
+                prev = a.address;
+            }
+            decoded += run;
+        }
+        if (decoded != accesses)
+            return false;
+    }
+    return out.size() == count;
+}
+
+bool isBinaryTrace(const string &filename)
+{
+    ifstream in(filename, ios::binary);
+    char magic[4];
+    return in.read(magic, 4) && memcmp(magic, BTRACE_MAGIC, 4) == 0;
+}
+
+bool writeBinaryTrace(const string &filename, const vector<vector<TraceAccess>> &cores, unsigned char flags)
+{
+    vector<string> payloads(cores.size());
+    for (size_t i = 0; i < cores.size(); i++)
+    {
+        if (flags & BTRACE_BLOCK_RLE)
+            encodeBlocks(cores[i], payloads[i]);
+        else
+            encodePlain(cores[i], payloads[i]);
+    }
+
+    string header(BTRACE_MAGIC, 4);
+    header.push_back((char)BTRACE_VERSION);
+    header.push_back((char)flags);
+    putFixed(header, cores.size(), 2);
+    for (size_t i = 0; i < cores.size(); i++)
+    {
+        putFixed(header, cores[i].size(), 8);
+        putFixed(header, payloads[i].size(), 8);
+    }
+
+    ofstream out(filename, ios::binary);
+    if (!out.is_open())
+    {
+        cerr << "Error: Could not open output file " << filename << endl;
+        return false;
+    }
+    out.write(header.data(), header.size());
+    for (const string &payload : payloads)
+        out.write(payload.data(), payload.size());
+    return (bool)out;
+}
+
+bool readBinaryTrace(const string &filename, vector<vector<TraceAccess>> &cores)
+{
+    ifstream in(filename, ios::binary);
+    if (!in.is_open())
+    {
+        cerr << "Error: Could not open trace file " << filename << endl;
+        return false;
+    }
+    string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const unsigned char *p = (const unsigned char *)file.data();
+    const unsigned char *end = p + file.size();
+
+    if (file.size() < 8 || memcmp(p, BTRACE_MAGIC, 4) != 0 || p[4] != BTRACE_VERSION)
+    {
+        cerr << "Error: " << filename << " is not a supported binary trace" << endl;
+        return false;
+    }
+    unsigned char flags = p[5];
+    size_t numCores = getFixed(p + 6, 2);
+    p += 8;
+    if ((size_t)(end - p) < numCores * 16)
+    {
+        cerr << "Error: Truncated binary trace header in " << filename << endl;
+        return false;
+    }
+    vector<unsigned long long> counts(numCores), sizes(numCores);
+    for (size_t i = 0; i < numCores; i++)
+    {
+        counts[i] = getFixed(p, 8);
+        sizes[i] = getFixed(p + 8, 8);
+        p += 16;
+    }
+
+    cores.assign(numCores, vector<TraceAccess>());
+    for (size_t i = 0; i < numCores; i++)
+    {
+        if (sizes[i] > (unsigned long long)(end - p))
+        {
+            cerr << "Error: Truncated binary trace payload in " << filename << endl;
+            return false;
+        }
+        // The count is not trusted: a corrupt one must fail the decoder
+        // below rather than this allocation
+        cores[i].reserve(min(counts[i], sizes[i]));
+        bool ok = (flags & BTRACE_BLOCK_RLE) ? decodeBlocks(p, p + sizes[i], counts[i], cores[i])
+                                             : decodePlain(p, p + sizes[i], counts[i], cores[i]);
+        if (!ok)
+        {
+            cerr << "Error: Corrupt payload for core " << i << " in " << filename << endl;
+            return false;
+        }
+        p += sizes[i];
+    }
+    return true;
+}
+
+bool TraceStream::open(const string &filename, size_t chunkEntries)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cerr << "Error: Could not open trace file " << filename << endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        cerr << "Error: Could not stat trace file " << filename << endl;
+        return false;
+    }
+    length = st.st_size;
+    if (length > 0)
+    {
+        void *m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+        {
+            ::close(fd);
+            cerr << "Error: Could not map trace file " << filename << endl;
+            return false;
+        }
+        data = (const char *)m;
+        madvise(m, length, MADV_SEQUENTIAL);
+    }
+    ::close(fd); // The mapping keeps the file alive
+
+    chunkSize = chunkEntries > 0 ? chunkEntries : 1;
+    current.clear();
+    current.reserve(chunkSize);
+    next.reserve(chunkSize);
+    cursor = released = base = 0;
+    currentLast = nextReady = nextLast = stopping = false;
+    numReads = numWrites = 0;
+    producer = thread(&TraceStream::fill, this);
+    return true;
+}
+
+void TraceStream::close()
+{
+    if (producer.joinable())
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        cv.notify_all();
+        producer.join();
+    }
+    if (data)
+    {
+        munmap((void *)data, length);
+        data = nullptr;
+    }
+    length = 0;
+    current.clear();
+    next.clear();
+}
+
+void TraceStream::fill()
+{
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(lock);
+            cv.wait(guard, [this] { return !nextReady || stopping; });
+            if (stopping)
+                return;
+        }
+
+        // Decode the next chunk outside the lock; the simulator only touches `current`
+        next.clear();
+        long long r = 0, w = 0;
+        while (next.size() < chunkSize && cursor < length)
+        {
+            const char *line = data + cursor;
+            const char *nl = (const char *)memchr(line, '\n', length - cursor);
+            const char *lineEnd = nl ? nl : data + length;
+            cursor = (lineEnd - data) + (nl ? 1 : 0);
+
+            TraceAccess access;
+            if (parseTraceLine(line, lineEnd, access))
+            {
+                next.push_back(access);
+                if (access.write)
+                    w++;
+                else
+                    r++;
+            }
+        }
+
+        {
+            lock_guard<mutex> guard(lock);
+            numReads += r;
+            numWrites += w;
+            nextBytes = cursor;
+            nextLast = (cursor >= length);
+            nextReady = true;
+        }
+        cv.notify_all();
+        if (cursor >= length)
+            return;
+    }
+}
+
+bool TraceStream::advance()
+{
+    if (currentLast)
+        return false;
+
+    size_t consumedBytes;
+    {
+        unique_lock<mutex> guard(lock);
+        cv.wait(guard, [this] { return nextReady; });
+        base += current.size();
+        current.swap(next);
+        currentLast = nextLast;
+        consumedBytes = nextBytes;
+        nextReady = false;
+    }
+    cv.notify_all();
+
+    // Drop pages of the mapping that are behind the chunk now being read, so
+    // resident memory stays bounded for very long traces.
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t upto = (consumedBytes / page) * page;
+    if (data && upto > released + (size_t)16 * page)
+    {
+        madvise((void *)(data + released), upto - released, MADV_DONTNEED);
+        released = upto;
+    }
+    return true;
+}
+
+long long TraceStream::reads()
+{
+    lock_guard<mutex> guard(lock);
+    return numReads;
+}
+
+long long TraceStream::writes()
+{
+    lock_guard<mutex> guard(lock);
+    return numWrites;
+}
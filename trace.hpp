@@ -0,0 +1,84 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "main.hpp"
+
+// Parses one trace line like "R 0x817b08" in [p, end). Returns false for blank
+// lines, comments and anything that is not a read or write.
+bool parseTraceLine(const char *p, const char *end, TraceAccess &out);
+
+// Reads a whole text trace file (one access per line) into out.
+bool loadTextTrace(const string &filename, vector<TraceAccess> &out);
+
+// Compact binary trace set: all cores of one application in a single
+// <prefix>.btr file. Header is the magic "L1TB", a version byte, a flags byte,
+// a 16-bit core count and, per core, the access count and payload size.
+// Each access is a varint of (zigzag(address delta) << 1 | write). With
+// BTRACE_BLOCK_RLE the payload is split into independently decodable blocks
+// and runs of identical records (constant-stride loops) are collapsed.
+const unsigned char BTRACE_BLOCK_RLE = 1;
+const string BTRACE_EXTENSION = ".btr";
+
+bool isBinaryTrace(const string &filename);
+bool writeBinaryTrace(const string &filename, const vector<vector<TraceAccess>> &cores, unsigned char flags);
+bool readBinaryTrace(const string &filename, vector<vector<TraceAccess>> &cores);
+
+// Streaming trace source for a single core. The file is memory-mapped and
+// decoded lazily in fixed-size chunks by a background thread that stays one
+// chunk ahead of the simulator, so memory use does not depend on trace length.
+class TraceStream
+{
+public:
+    TraceStream() {}
+    ~TraceStream() { close(); }
+
+    bool open(const string &filename, size_t chunkEntries);
+    void close();
+
+    // Returns the access at position pos, or nullptr once the trace is exhausted.
+    // Positions must be requested in non-decreasing order.
+    const TraceAccess *get(size_t pos)
+    {
+        while (pos >= base + current.size())
+        {
+            if (!advance())
+                return nullptr;
+        }
+        return &current[pos - base];
+    }
+
+    long long reads();
+    long long writes();
+
+private:
+    bool advance(); // Swap in the next chunk; false at end of trace
+    void fill();    // Background producer loop
+
+    const char *data = nullptr; // Mapped file contents
+    size_t length = 0;
+    size_t cursor = 0;   // Next byte for the producer to decode
+    size_t released = 0; // Bytes already handed back to the kernel
+    size_t chunkSize = 0;
+
+    vector<TraceAccess> current; // Chunk the simulator is reading from
+    vector<TraceAccess> next;    // Chunk being filled by the producer
+    size_t nextBytes = 0;        // File offset reached by the next chunk
+    size_t base = 0;             // Trace position of current[0]
+    bool currentLast = false;    // current is the final chunk
+    bool nextReady = false;
+    bool nextLast = false;
+    bool stopping = false;
+    long long numReads = 0;
+    long long numWrites = 0;
+
+    thread producer;
+    mutex lock;
+    condition_variable cv;
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include "trace.hpp"
+
+using namespace std;
+
+// Converts the text traces <prefix>_proc0.trace .. <prefix>_proc{n-1}.trace
+// into a single binary trace set that L1simulate picks up automatically.
+
+void printUsage(const char *progName)
+{
+    cout << "Usage: " << progName << " -t <tracefile> [-n <cores>] [-z] [-o <outfilename>] [-h]\n"
+         << "\nOptions:\n"
+         << "  -t <tracefile>  Name of the parallel application (e.g. app1) whose traces are\n"
+         << "                  to be converted.\n"
+         << "  -n <cores>      Number of per-core trace files to read (default 4).\n"
+         << "  -z              Use the block run-length compressed variant.\n"
+         << "  -o <outfilename>Output file (default <tracefile>.btr).\n"
+         << "  -h              Print this help message.\n";
+}
+
+int main(int argc, char *argv[])
+{
+    string tracePrefix;
+    string outfilename;
+    int cores = 4;
+    unsigned char flags = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-z") == 0)
+        {
+            flags |= BTRACE_BLOCK_RLE;
+        }
+        else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "-o") == 0) && i + 1 < argc)
+        {
+            char opt = argv[i][1];
+            const char *value = argv[++i];
+            if (opt == 't')
+                tracePrefix = value;
+            else if (opt == 'n')
+                cores = atoi(value);
+            else
+                outfilename = value;
+        }
+        else
+        {
+            cerr << "Error: Unknown option or missing argument " << argv[i] << ".\n";
+            return 1;
+        }
+    }
+
+    if (tracePrefix.empty() || cores <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (outfilename.empty())
+    {
+        outfilename = tracePrefix + BTRACE_EXTENSION;
+    }
+
+    vector<vector<TraceAccess>> traces(cores);
+    long long total = 0;
+    for (int i = 0; i < cores; i++)
+    {
+        string filename = tracePrefix + "_proc" + to_string(i) + ".trace";
+        if (!loadTextTrace(filename, traces[i]))
+        {
+            return 1;
+        }
+        total += traces[i].size();
+    }
+
+    if (!writeBinaryTrace(outfilename, traces, flags))
+    {
+        return 1;
+    }
+    cout << "Wrote " << total << " accesses for " << cores << " cores to " << outfilename << endl;
+    return 0;
+}
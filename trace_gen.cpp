@@ -0,0 +1,373 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+// Writes synthetic per-core trace sets <prefix>_proc0.trace ..
+// <prefix>_proc{n-1}.trace from parameterized access patterns. Every access
+// of a core picks one of the requested patterns by weight; each pattern has
+// its own 256 MB address region, so patterns never share blocks by accident.
+// The same options and seed always give the same traces.
+
+enum class Pattern
+{
+    Private,   // Each core streams through its own array, word by word
+    Strided,   // Each core walks its own array with a fixed stride
+    Random,    // Each core reads and writes uniformly random words of its own working set
+    Producer,  // Core 0 writes a shared buffer in order, the others read it in the same order
+    Migratory, // Objects move from core to core, each reading then writing every word of one
+    True,      // All cores read and write random words of one shared working set
+    False      // Each core uses its own word of blocks that all cores share
+};
+
+const char *PATTERN_NAMES[] = {"private", "strided", "random", "producer", "migratory", "true", "false"};
+const int PATTERN_COUNT = 7;
+const unsigned int REGION_BITS = 28; // Address region of each pattern
+
+struct PatternWeight
+{
+    Pattern pattern;
+    int weight;
+};
+
+// Generator settings, shared read-only by the per-core threads
+struct GenConfig
+{
+    string prefix;
+    int cores = 4;
+    long long length = 100000;        // Accesses per core
+    unsigned int footprint = 1 << 16; // Bytes per core (private patterns) or shared
+    int writePercent = 30;
+    int b = 5;                        // Block bits, for false sharing and migratory objects
+    unsigned int stride = 64;         // Bytes, for strided
+    unsigned int offset = 4;          // Bytes between the cores' words, for false sharing
+    unsigned long long seed = 1;
+    vector<PatternWeight> mix;
+};
+
+void printUsage(const char *progName)
+{
+    cout << "Usage: " << progName << " -t <tracefile> -p <pattern>[:<weight>][,...] [options] [-h]\n"
+         << "\nPatterns:\n"
+         << "  private         Each core streams through its own array of <footprint> bytes.\n"
+         << "  strided         Each core walks its own array with a stride of --stride bytes.\n"
+         << "  random          Uniformly random words of each core's own working set.\n"
+         << "  producer        Core 0 writes a shared buffer in order, the others read it.\n"
+         << "  migratory       Blocks move from core to core; each core reads and writes\n"
+         << "                  every word of one block, then moves on to the next.\n"
+         << "  true            Random reads and writes of one working set shared by all cores.\n"
+         << "  false           Each core reads and writes its own word, --offset bytes from\n"
+         << "                  its neighbour's, in blocks that all cores use.\n"
+         << "  Several patterns, e.g. private:90,true:10, are mixed access by access by weight.\n"
+         << "\nOptions:\n"
+         << "  -t <tracefile>  Prefix of the trace files to write.\n"
+         << "  -n <cores>      Number of cores (default 4).\n"
+         << "  -l <length>     Accesses per core (default 100000; k, m and g multiply by\n"
+         << "                  powers of 1000, so 2g is two billion).\n"
+         << "  -f <bytes>      Footprint: per core for private, strided and random, shared\n"
+         << "                  otherwise (default 65536; k, m and g are powers of 1024).\n"
+         << "  -w <percent>    Share of writes (default 30); producer and migratory fix\n"
+         << "                  their own.\n"
+         << "  -b <b>          Block bits of the simulated cache (default 5).\n"
+         << "  --stride <n>    Stride in bytes for strided (default 64).\n"
+         << "  --offset <n>    Bytes between the cores' words for false (default 4); an\n"
+         << "                  offset of a whole block gives the padded layout.\n"
+         << "  --seed <n>      Random seed (default 1).\n"
+         << "  -h              Print this help message.\n";
+}
+
+// A number with an optional k, m or g suffix: unit, unit^2 or unit^3 times it
+static bool parseSize(const char *text, unsigned long long &value, unsigned long long unit)
+{
+    char *end;
+    value = strtoull(text, &end, 10);
+    if (end == text)
+        return false;
+    if (*end == 'k' || *end == 'K')
+        value *= unit, end++;
+    else if (*end == 'm' || *end == 'M')
+        value *= unit * unit, end++;
+    else if (*end == 'g' || *end == 'G')
+        value *= unit * unit * unit, end++;
+    return *end == '\0';
+}
+
+static bool parseMix(const string &spec, vector<PatternWeight> &mix)
+{
+    size_t start = 0;
+    while (start <= spec.size())
+    {
+        size_t comma = spec.find(',', start);
+        string item = spec.substr(start, comma == string::npos ? string::npos : comma - start);
+        string name = item.substr(0, item.find(':'));
+        int weight = 1;
+        if (name.size() < item.size() && (weight = atoi(item.c_str() + name.size() + 1)) < 1)
+            return false;
+        int k = 0;
+        while (k < PATTERN_COUNT && name != PATTERN_NAMES[k])
+            k++;
+        if (k == PATTERN_COUNT)
+            return false;
+        mix.push_back(PatternWeight{(Pattern)k, weight});
+        if (comma == string::npos)
+            break;
+        start = comma + 1;
+    }
+    return !mix.empty();
+}
+
+// xorshift64, seeded per core so the cores are generated independently
+struct GenRandom
+{
+    unsigned long long state;
+
+    unsigned int next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (unsigned int)(state >> 32);
+    }
+    unsigned int below(unsigned int n) { return (unsigned int)(((unsigned long long)next() * n) >> 32); }
+};
+
+// Produces the accesses of one core. Each pattern keeps its own position,
+// counted in the accesses that core has drawn from it.
+class CoreGenerator
+{
+public:
+    CoreGenerator(const GenConfig &config, int core) : config(config), core(core), position(PATTERN_COUNT, 0)
+    {
+        random.state = config.seed * 0x9e3779b97f4a7c15ULL + (unsigned long long)core * 0xbf58476d1ce4e5b9ULL + 1;
+        for (const PatternWeight &w : config.mix)
+            totalWeight += w.weight;
+        blockSize = 1u << config.b;
+        // False sharing: each group of blocks holds one word of every core
+        falseSlot = (config.cores * config.offset + blockSize - 1) / blockSize * blockSize;
+    }
+
+    void next(unsigned int &addr, bool &write)
+    {
+        Pattern pattern = config.mix[0].pattern;
+        if (config.mix.size() > 1)
+        {
+            int pick = (int)random.below(totalWeight);
+            for (const PatternWeight &w : config.mix)
+            {
+                if (pick < w.weight)
+                {
+                    pattern = w.pattern;
+                    break;
+                }
+                pick -= w.weight;
+            }
+        }
+        long long k = position[(int)pattern]++;
+        unsigned int base = ((unsigned int)pattern + 1) << REGION_BITS;
+        unsigned int words = config.footprint / 4;
+        unsigned int privateBase = base + (unsigned int)core * config.footprint;
+        write = (int)random.below(100) < config.writePercent;
+        switch (pattern)
+        {
+        case Pattern::Private:
+            addr = privateBase + (unsigned int)(k % words) * 4;
+            break;
+        case Pattern::Strided:
+        {
+            // Each pass over the array starts one word further in
+            unsigned long long steps = config.footprint / config.stride;
+            if (steps == 0)
+                steps = 1;
+            unsigned int pass = (unsigned int)(k / steps);
+            addr = privateBase + (unsigned int)((k % steps) * config.stride + pass * 4 % config.stride) % config.footprint;
+            break;
+        }
+        case Pattern::Random:
+            addr = privateBase + random.below(words) * 4;
+            break;
+        case Pattern::Producer:
+            addr = base + (unsigned int)(k % words) * 4;
+            write = core == 0;
+            break;
+        case Pattern::Migratory:
+        {
+            // A read and a write of every word of the object, then the next
+            // one; the cores start on different objects and follow each other
+            unsigned int objectWords = blockSize / 4;
+            unsigned int objects = config.footprint / blockSize;
+            long long visit = k / (2 * objectWords);
+            unsigned int object = (unsigned int)((visit + core) % objects);
+            addr = base + object * blockSize + (unsigned int)(k / 2 % objectWords) * 4;
+            write = k % 2 == 1;
+            break;
+        }
+        case Pattern::True:
+            addr = base + random.below(words) * 4;
+            break;
+        case Pattern::False:
+        {
+            unsigned int slots = config.footprint / falseSlot;
+            addr = base + (unsigned int)(k % slots) * falseSlot + (unsigned int)core * config.offset;
+            break;
+        }
+        }
+    }
+
+private:
+    const GenConfig &config;
+    int core;
+    GenRandom random;
+    vector<long long> position;
+    int totalWeight = 0;
+    unsigned int blockSize;
+    unsigned int falseSlot;
+};
+
+// Writes one core's trace through a large buffer; lines are formatted by
+// hand since fprintf dominates at billions of accesses
+static bool writeCore(const GenConfig &config, int core)
+{
+    string filename = config.prefix + "_proc" + to_string(core) + ".trace";
+    FILE *out = fopen(filename.c_str(), "w");
+    if (!out)
+    {
+        cerr << "Error: Could not open output file " << filename << endl;
+        return false;
+    }
+    static const char HEX[] = "0123456789abcdef";
+    const size_t LINE = 13; // "R 0x" + 8 digits + newline
+    vector<char> buffer(LINE << 16);
+    size_t used = 0;
+    bool ok = true;
+    CoreGenerator gen(config, core);
+    for (long long k = 0; k < config.length && ok; k++)
+    {
+        unsigned int addr;
+        bool write;
+        gen.next(addr, write);
+        char *p = &buffer[used];
+        p[0] = write ? 'W' : 'R';
+        p[1] = ' ';
+        p[2] = '0';
+        p[3] = 'x';
+        for (int d = 0; d < 8; d++)
+            p[4 + d] = HEX[(addr >> (28 - 4 * d)) & 15];
+        p[12] = '\n';
+        used += LINE;
+        if (used == buffer.size())
+        {
+            ok = fwrite(buffer.data(), 1, used, out) == used;
+            used = 0;
+        }
+    }
+    ok = ok && fwrite(buffer.data(), 1, used, out) == used;
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+    {
+        cerr << "Error: Could not write " << filename << endl;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    GenConfig config;
+    string mixSpec;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            cerr << "Error: Unknown option or missing argument " << argv[i] << ".\n";
+            return 1;
+        }
+        const char *value = argv[++i];
+        unsigned long long size = 0;
+        const char *opt = argv[i - 1];
+        if (strcmp(opt, "-t") == 0)
+            config.prefix = value;
+        else if (strcmp(opt, "-p") == 0)
+            mixSpec = value;
+        else if (strcmp(opt, "-n") == 0)
+            config.cores = atoi(value);
+        else if (strcmp(opt, "-l") == 0 && parseSize(value, size, 1000))
+            config.length = (long long)size;
+        else if (strcmp(opt, "-f") == 0 && parseSize(value, size, 1024) && size <= (1ULL << REGION_BITS))
+            config.footprint = (unsigned int)size;
+        else if (strcmp(opt, "-w") == 0)
+            config.writePercent = atoi(value);
+        else if (strcmp(opt, "-b") == 0)
+            config.b = atoi(value);
+        else if (strcmp(opt, "--stride") == 0 && parseSize(value, size, 1024))
+            config.stride = (unsigned int)size;
+        else if (strcmp(opt, "--offset") == 0 && parseSize(value, size, 1024))
+            config.offset = (unsigned int)size;
+        else if (strcmp(opt, "--seed") == 0 && parseSize(value, size, 1000))
+            config.seed = size;
+        else
+        {
+            cerr << "Error: Invalid option " << opt << " " << value << ".\n";
+            return 1;
+        }
+    }
+
+    if (config.prefix.empty() || mixSpec.empty())
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!parseMix(mixSpec, config.mix))
+    {
+        cerr << "Error: Invalid pattern " << mixSpec << ".\n";
+        return 1;
+    }
+    if (config.cores < 1 || config.cores > 64 || config.length < 0 || config.writePercent < 0 ||
+        config.writePercent > 100 || config.b < 2 || config.b > 12 || config.stride < 4 || config.offset < 4)
+    {
+        cerr << "Error: Invalid cores, length, write share, block bits, stride or offset.\n";
+        return 1;
+    }
+    // Private regions of all cores, and the false-sharing slots, must fit
+    // in one pattern's region and hold at least one block
+    unsigned int blockSize = 1u << config.b;
+    config.footprint &= ~3u;
+    unsigned long long falseSlot = (config.cores * (unsigned long long)config.offset + blockSize - 1) / blockSize * blockSize;
+    if (config.footprint < blockSize || config.footprint < falseSlot ||
+        (unsigned long long)config.footprint * config.cores > (1ULL << REGION_BITS))
+    {
+        cerr << "Error: Footprint must hold a block (and a false-sharing slot), and "
+             << config.cores << " private footprints must fit in " << (1 << (REGION_BITS - 20)) << " MB.\n";
+        return 1;
+    }
+
+    // One thread per core; each core's trace depends on its own seed only
+    vector<thread> workers;
+    vector<char> ok(config.cores, 0);
+    for (int i = 0; i < config.cores; i++)
+    {
+        workers.emplace_back([&config, &ok, i]() { ok[i] = writeCore(config, i); });
+    }
+    bool allOk = true;
+    for (int i = 0; i < config.cores; i++)
+    {
+        workers[i].join();
+        allOk = allOk && ok[i];
+    }
+    if (!allOk)
+    {
+        return 1;
+    }
+    cout << "Wrote " << config.length << " accesses for each of " << config.cores << " cores to " << config.prefix
+         << "_proc*.trace" << endl;
+    return 0;
+}